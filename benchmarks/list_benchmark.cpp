@@ -0,0 +1,314 @@
+// Compares List with different allocators against std::list and std::vector.
+//
+//   g++ -std=c++20 -O2 -march=native -pthread benchmarks/list_benchmark.cpp -o list_benchmark
+//   ./list_benchmark [max_size]
+//
+// Columns are per element: cycles (rdtsc, or nanoseconds on other targets),
+// calls to global operator new, and hardware cache misses (perf_event, Linux only;
+// "n/a" when the kernel does not allow it, see /proc/sys/kernel/perf_event_paranoid).
+#include "../stackallocator.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static size_t allocation_count = 0;
+
+void* operator new(size_t size) {
+  ++allocation_count;
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+  ++allocation_count;
+  size_t alignment = std::max(static_cast<size_t>(align), sizeof(void*));
+  if (void* ptr = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+namespace {
+
+uint64_t cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class CacheMissCounter {
+  private:
+  int fd = -1;
+
+  public:
+  CacheMissCounter() {
+#ifdef __linux__
+    perf_event_attr attr {};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+  CacheMissCounter(const CacheMissCounter&) = delete;
+  CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+  ~CacheMissCounter() {
+#ifdef __linux__
+    if (fd != -1) {
+      close(fd);
+    }
+#endif
+  }
+
+  bool available() const { return fd != -1; }
+
+  void start() {
+#ifdef __linux__
+    if (fd != -1) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  uint64_t stop() {
+    uint64_t count = 0;
+#ifdef __linux__
+    if (fd != -1) {
+      ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        count = 0;
+      }
+    }
+#endif
+    return count;
+  }
+};
+
+CacheMissCounter cache_misses;
+
+struct Measurement {
+  uint64_t cycles = UINT64_MAX;
+  size_t allocations = 0;
+  uint64_t cache_misses = 0;
+};
+
+class Probe {
+  private:
+  Measurement& result;
+  uint64_t start_cycles;
+  size_t start_allocations;
+
+  public:
+  explicit Probe(Measurement& measurement) : result(measurement) {
+    start_allocations = allocation_count;
+    cache_misses.start();
+    start_cycles = cycles();
+  }
+
+  ~Probe() {
+    uint64_t elapsed = cycles() - start_cycles;
+    uint64_t misses = cache_misses.stop();
+    if (elapsed < result.cycles) {
+      result = Measurement{elapsed, allocation_count - start_allocations, misses};
+    }
+  }
+};
+
+struct Large {
+  long payload[16];
+
+  Large(int value = 0) { std::fill(payload, payload + 16, value); }
+  operator long() const { return payload[0]; }
+};
+
+constexpr size_t kArenaSize = 1 << 16;
+
+template <typename Container>
+struct Plain {
+  Container make() { return Container(); }
+};
+
+template <typename T>
+struct Stacked {
+  std::unique_ptr<StackStorage<kArenaSize>> storage = std::make_unique<StackStorage<kArenaSize>>();
+  List<T, StackAllocator<T, kArenaSize>> make() { return List<T, StackAllocator<T, kArenaSize>>(*storage); }
+};
+
+template <typename Container>
+constexpr bool is_vector = false;
+
+template <typename T>
+constexpr bool is_vector<std::vector<T>> = true;
+
+volatile long sink = 0;
+
+template <typename Fixture>
+Measurement push_back(size_t n, int trials) {
+  Measurement result;
+  for (int trial = 0; trial < trials; ++trial) {
+    Fixture fixture;
+    auto container = fixture.make();
+    {
+      Probe probe(result);
+      for (size_t i = 0; i < n; ++i) {
+        container.push_back(static_cast<int>(i));
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Fixture>
+Measurement pop_back(size_t n, int trials) {
+  Measurement result;
+  for (int trial = 0; trial < trials; ++trial) {
+    Fixture fixture;
+    auto container = fixture.make();
+    for (size_t i = 0; i < n; ++i) {
+      container.push_back(static_cast<int>(i));
+    }
+    {
+      Probe probe(result);
+      for (size_t i = 0; i < n; ++i) {
+        container.pop_back();
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Fixture>
+Measurement insert_front(size_t n, int trials) {
+  Measurement result;
+  for (int trial = 0; trial < trials; ++trial) {
+    Fixture fixture;
+    auto container = fixture.make();
+    {
+      Probe probe(result);
+      for (size_t i = 0; i < n; ++i) {
+        container.insert(container.begin(), static_cast<int>(i));
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Fixture>
+Measurement erase_front(size_t n, int trials) {
+  Measurement result;
+  for (int trial = 0; trial < trials; ++trial) {
+    Fixture fixture;
+    auto container = fixture.make();
+    for (size_t i = 0; i < n; ++i) {
+      container.push_back(static_cast<int>(i));
+    }
+    {
+      Probe probe(result);
+      for (size_t i = 0; i < n; ++i) {
+        container.erase(container.begin());
+      }
+    }
+  }
+  return result;
+}
+
+template <typename Fixture>
+Measurement iterate(size_t n, int trials) {
+  Measurement result;
+  Fixture fixture;
+  auto container = fixture.make();
+  for (size_t i = 0; i < n; ++i) {
+    container.push_back(static_cast<int>(i));
+  }
+  for (int trial = 0; trial < trials; ++trial) {
+    Probe probe(result);
+    long sum = 0;
+    for (const auto& value : container) {
+      sum += static_cast<long>(value);
+    }
+    sink = sum;
+  }
+  return result;
+}
+
+void print_row(const std::string& container, const std::string& workload, size_t n, const Measurement& result) {
+  double per_element = static_cast<double>(std::max<size_t>(n, 1));
+  std::cout << std::left << std::setw(28) << container << std::setw(14) << workload
+            << std::right << std::setw(9) << n << std::fixed << std::setprecision(2)
+            << std::setw(12) << result.cycles / per_element
+            << std::setw(10) << result.allocations / per_element;
+  if (cache_misses.available()) {
+    std::cout << std::setw(12) << result.cache_misses / per_element << '\n';
+  } else {
+    std::cout << std::setw(12) << "n/a" << '\n';
+  }
+}
+
+template <typename Fixture>
+void run(const std::string& name, size_t n) {
+  constexpr int kTrials = 5;
+  using Container = decltype(std::declval<Fixture&>().make());
+  print_row(name, "push_back", n, push_back<Fixture>(n, kTrials));
+  print_row(name, "pop_back", n, pop_back<Fixture>(n, kTrials));
+  print_row(name, "iterate", n, iterate<Fixture>(n, kTrials));
+  // Front insertion and erasure are quadratic for std::vector.
+  if (!is_vector<Container> || n <= 10000) {
+    print_row(name, "insert_front", n, insert_front<Fixture>(n, kTrials));
+    print_row(name, "erase_front", n, erase_front<Fixture>(n, kTrials));
+  }
+}
+
+template <typename T>
+void run_all(const std::string& type, size_t n) {
+  run<Plain<std::vector<T>>>("std::vector<" + type + ">", n);
+  run<Plain<std::list<T>>>("std::list<" + type + ">", n);
+  run<Plain<List<T>>>("List<" + type + ">", n);
+  run<Stacked<T>>("List<" + type + ", Stack>", n);
+  run<Plain<List<T, PoolAllocator<T>>>>("List<" + type + ", Pool>", n);
+  run<Plain<UnrolledList<T>>>("UnrolledList<" + type + ">", n);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t max_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+  std::cout << std::left << std::setw(28) << "container" << std::setw(14) << "workload"
+            << std::right << std::setw(9) << "n" << std::setw(12) << "cycles/op"
+            << std::setw(10) << "allocs/op" << std::setw(12) << "misses/op" << '\n';
+  for (size_t n = 1000; n <= max_size; n *= 10) {
+    run_all<int>("int", n);
+    run_all<Large>("Large", n);
+  }
+}
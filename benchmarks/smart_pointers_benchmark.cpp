@@ -0,0 +1,239 @@
+// Compares SharedPtr/WeakPtr with std::shared_ptr/std::weak_ptr.
+//
+//   g++ -std=c++20 -O2 -pthread benchmarks/smart_pointers_benchmark.cpp -o smart_pointers_benchmark
+//   ./smart_pointers_benchmark [threads] > results.json
+//
+// Prints one JSON object: a "results" array with nanoseconds and global
+// operator new calls per operation, and a "footprint" section with the bytes
+// allocated per owned object.
+#include "../smart_pointers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<size_t> allocation_count {0};
+static std::atomic<size_t> allocation_bytes {0};
+
+void* operator new(size_t size) {
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+// Out of line so GCC does not pair the inlined free with a new-expression.
+[[gnu::noinline]] void operator delete(void* ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+template <typename T>
+void escape(const T& value) {
+  asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Payload {
+  long value[4] = {1, 2, 3, 4};
+};
+
+struct StdImpl {
+  static constexpr const char* name = "std::shared_ptr";
+  template <typename T> using Shared = std::shared_ptr<T>;
+  template <typename T> using Weak = std::weak_ptr<T>;
+
+  template <typename T>
+  static Shared<T> make() { return std::make_shared<T>(); }
+
+  template <typename T>
+  static Shared<T> adopt(T* p) { return Shared<T>(p); }
+};
+
+template <typename RefCount>
+struct OwnImpl {
+  static constexpr const char* name =
+    std::is_same_v<RefCount, PlainRefCount> ? "SharedPtr<PlainRefCount>" : "SharedPtr<AtomicRefCount>";
+  template <typename T> using Shared = SharedPtr<T, RefCount>;
+  template <typename T> using Weak = WeakPtr<T, RefCount>;
+
+  template <typename T>
+  static Shared<T> make() { return makeShared<T, RefCount>(); }
+
+  template <typename T>
+  static Shared<T> adopt(T* p) { return Shared<T>(p); }
+};
+
+struct Result {
+  std::string benchmark;
+  std::string impl;
+  int threads;
+  size_t operations;
+  double nsPerOp;
+  double allocationsPerOp;
+};
+
+std::vector<Result> results;
+
+// Runs body(threadIndex) on threads threads and records the slowest thread's time.
+template <typename Body>
+void measure(const std::string& benchmark, const char* impl, int threads, size_t operations, Body body) {
+  size_t allocationsBefore = allocation_count.load();
+  std::atomic<int> ready {0};
+  std::atomic<bool> go {false};
+  std::vector<double> elapsed(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {}
+      auto start = std::chrono::steady_clock::now();
+      body(t);
+      elapsed[t] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    });
+  }
+  while (ready.load() != threads) {}
+  go.store(true, std::memory_order_release);
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  double slowest = 0;
+  for (double time : elapsed) {
+    slowest = std::max(slowest, time);
+  }
+  size_t allocations = allocation_count.load() - allocationsBefore;
+  results.push_back(Result{benchmark, impl, threads, operations, slowest / operations,
+                           static_cast<double>(allocations) / (operations * threads)});
+}
+
+template <typename Impl>
+void singleThreaded(size_t n) {
+  using Shared = typename Impl::template Shared<Payload>;
+  using Weak = typename Impl::template Weak<Payload>;
+
+  measure("make_shared", Impl::name, 1, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      auto p = Impl::template make<Payload>();
+      escape(p);
+    }
+  });
+  measure("adopt_raw_pointer", Impl::name, 1, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      auto p = Impl::adopt(new Payload());
+      escape(p);
+    }
+  });
+  Shared shared = Impl::template make<Payload>();
+  measure("copy_destroy", Impl::name, 1, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      Shared copy = shared;
+      escape(copy);
+    }
+  });
+  measure("move", Impl::name, 1, n, [&](int) {
+    Shared a = shared;
+    for (size_t i = 0; i < n; ++i) {
+      Shared b = std::move(a);
+      escape(b);
+      a = std::move(b);
+    }
+  });
+  Weak weak = shared;
+  measure("weak_lock", Impl::name, 1, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      auto locked = weak.lock();
+      escape(locked);
+    }
+  });
+  measure("weak_copy_destroy", Impl::name, 1, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      Weak copy = weak;
+      escape(copy);
+    }
+  });
+}
+
+template <typename Impl>
+void contended(size_t n, int threads) {
+  using Shared = typename Impl::template Shared<Payload>;
+  using Weak = typename Impl::template Weak<Payload>;
+
+  Shared shared = Impl::template make<Payload>();
+  measure("contended_copy_destroy", Impl::name, threads, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      Shared copy = shared;
+      escape(copy);
+    }
+  });
+  Weak weak = shared;
+  measure("contended_weak_lock", Impl::name, threads, n, [&](int) {
+    for (size_t i = 0; i < n; ++i) {
+      auto locked = weak.lock();
+      escape(locked);
+    }
+  });
+  std::vector<Shared> own(threads);
+  for (auto& p : own) {
+    p = Impl::template make<Payload>();
+  }
+  measure("uncontended_copy_destroy", Impl::name, threads, n, [&](int t) {
+    for (size_t i = 0; i < n; ++i) {
+      Shared copy = own[t];
+      escape(copy);
+    }
+  });
+}
+
+template <typename Make>
+size_t bytesPerObject(Make make) {
+  size_t before = allocation_bytes.load();
+  auto p = make();
+  escape(p);
+  return allocation_bytes.load() - before;
+}
+
+void printJson(int threads) {
+  std::cout << "{\n  \"threads\": " << threads << ",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Result& r = results[i];
+    std::cout << "    {\"benchmark\": \"" << r.benchmark << "\", \"impl\": \"" << r.impl
+              << "\", \"threads\": " << r.threads << ", \"operations\": " << r.operations
+              << ", \"ns_per_op\": " << r.nsPerOp << ", \"allocations_per_op\": " << r.allocationsPerOp
+              << '}' << (i + 1 == results.size() ? "\n" : ",\n");
+  }
+  std::cout << "  ],\n  \"footprint\": {\n"
+            << "    \"sizeof_shared_ptr\": " << sizeof(std::shared_ptr<Payload>) << ",\n"
+            << "    \"sizeof_SharedPtr\": " << sizeof(SharedPtr<Payload>) << ",\n"
+            << "    \"sizeof_Payload\": " << sizeof(Payload) << ",\n"
+            << "    \"std_make_shared_bytes\": "
+            << bytesPerObject([] { return std::make_shared<Payload>(); }) << ",\n"
+            << "    \"std_adopt_bytes\": "
+            << bytesPerObject([] { return std::shared_ptr<Payload>(new Payload()); }) << ",\n"
+            << "    \"makeShared_bytes\": "
+            << bytesPerObject([] { return makeShared<Payload>(); }) << ",\n"
+            << "    \"adopt_bytes\": "
+            << bytesPerObject([] { return SharedPtr<Payload>(new Payload()); }) << ",\n"
+            << "    \"control_block_header\": " << sizeof(BaseControlBlock<AtomicRefCount>) << "\n"
+            << "  }\n}\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int threads = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+  constexpr size_t kSingle = 2000000;
+  constexpr size_t kContended = 500000;
+
+  singleThreaded<StdImpl>(kSingle);
+  singleThreaded<OwnImpl<AtomicRefCount>>(kSingle);
+  singleThreaded<OwnImpl<PlainRefCount>>(kSingle);
+  contended<StdImpl>(kContended, threads);
+  contended<OwnImpl<AtomicRefCount>>(kContended, threads);
+
+  printJson(threads);
+}
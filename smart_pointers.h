@@ -1,60 +1,420 @@
 #include <iostream>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <chrono>
+#include <type_traits>
+#include <vector>
 
+class AtomicRefCount {
+  public:
+  explicit AtomicRefCount(uint32_t initial) : count(initial) {}
+
+  void increment(uint32_t amount = 1) {
+    count.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  // Returns true when the count dropped to zero.
+  bool decrement(uint32_t amount = 1) {
+    return count.fetch_sub(amount, std::memory_order_acq_rel) == amount;
+  }
+
+  bool incrementIfNotZero() {
+    uint32_t current = count.load(std::memory_order_relaxed);
+    while (current != 0) {
+      if (count.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  size_t load() const {
+    return count.load(std::memory_order_acquire);
+  }
+
+  private:
+  std::atomic<uint32_t> count;
+};
+
+class PlainRefCount {
+  public:
+  explicit PlainRefCount(uint32_t initial) : count(initial) {}
+
+  void increment(uint32_t amount = 1) {
+    count += amount;
+  }
+
+  bool decrement(uint32_t amount = 1) {
+    return (count -= amount) == 0;
+  }
+
+  bool incrementIfNotZero() {
+    if (count == 0) {
+      return false;
+    }
+    ++count;
+    return true;
+  }
+
+  size_t load() const {
+    return count;
+  }
+
+  private:
+  uint32_t count;
+};
+
+// Atomic counting, but the final release hands the block to
+// ReclaimQueue<DeferredRefCount> instead of destroying the object in place.
+class DeferredRefCount : public AtomicRefCount {
+  public:
+  using AtomicRefCount::AtomicRefCount;
+};
+
+using DefaultRefCount = AtomicRefCount;
+
+template <typename RefCount>
+constexpr bool isDeferredRefCount = std::is_same_v<RefCount, DeferredRefCount>;
+
+template <typename RefCount>
+class ReclaimQueue;
+
+template <typename RefCount>
+struct BaseControlBlock;
+
+template <typename T, typename RefCount>
+class SharedPtr;
+
+// Collects the control blocks an object points to; see ControlBlockRegistry::findCycles.
+class SharedEdgeVisitor {
+  public:
+  template <typename U, typename R>
+  void operator()(const SharedPtr<U, R>& p) {
+    if (p.data != nullptr) {
+      targets.push_back(p.data);
+    }
+  }
+
+  std::vector<const void*> targets;
+};
+
+#ifdef SMART_POINTERS_DEBUG
+#include <mutex>
+#include <unordered_map>
+#include <typeinfo>
+#include <algorithm>
+#include <cstdlib>
+
+// Registry of live control blocks, compiled in with SMART_POINTERS_DEBUG.
+// Types opt into cycle detection by providing
+//   void visitSharedEdges(const T&, SharedEdgeVisitor&)
+// that passes every SharedPtr member to the visitor.
+class ControlBlockRegistry {
+  public:
+  struct Entry {
+    uint64_t id;
+    const char* type;
+    const void* object;
+    const char* file;
+    int line;
+    size_t (*sharedCount)(const void* block);
+    void (*visitEdges)(const void* object, SharedEdgeVisitor& visitor);
+  };
+
+  // Tags blocks created during one full expression, see SMART_POINTERS_TRACE.
+  class CallSite {
+    public:
+    CallSite(const char* file, int line) {
+      current() = Location{file, line};
+    }
+
+    ~CallSite() {
+      current() = Location{nullptr, 0};
+    }
+  };
+
+  // Never destroyed, so pointers released during static destruction stay safe.
+  static ControlBlockRegistry& instance() {
+    static ControlBlockRegistry* registry = [] {
+      auto* created = new ControlBlockRegistry();
+      std::atexit([] {
+        if (instance().reportAtExit) {
+          instance().reportLeaks(std::cerr);
+        }
+      });
+      return created;
+    }();
+    return *registry;
+  }
+
+  template <typename U, typename RefCount>
+  void add(const BaseControlBlock<RefCount>* block, const U* object) {
+    Entry entry {nextId++, typeid(U).name(), object, current().file, current().line,
+                 [](const void* b) -> size_t {
+                   return static_cast<const BaseControlBlock<RefCount>*>(b)->countShared.load();
+                 },
+                 nullptr};
+    if constexpr (requires(const U& u, SharedEdgeVisitor& v) { visitSharedEdges(u, v); }) {
+      entry.visitEdges = [](const void* o, SharedEdgeVisitor& v) {
+        visitSharedEdges(*static_cast<const U*>(o), v);
+      };
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    entries[block] = entry;
+  }
+
+  void remove(const void* block) {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.erase(block);
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+  }
+
+  void setReportAtExit(bool enabled) {
+    reportAtExit = enabled;
+  }
+
+  void dump(std::ostream& out) {
+    for (const auto& [block, entry] : snapshot()) {
+      print(out, block, entry);
+    }
+  }
+
+  // Blocks still registered, including ones kept alive only by WeakPtrs.
+  size_t reportLeaks(std::ostream& out) {
+    auto live = snapshot();
+    if (!live.empty()) {
+      out << live.size() << " control block(s) still alive:\n";
+      for (const auto& [block, entry] : live) {
+        print(out, block, entry);
+      }
+    }
+    return live.size();
+  }
+
+  // Returns cycles of SharedPtr edges as lists of block ids. Walks the objects
+  // directly, so the graph must not change while this runs.
+  std::vector<std::vector<uint64_t>> findCycles() {
+    auto live = snapshot();
+    std::unordered_map<const void*, size_t> index;
+    for (size_t i = 0; i < live.size(); ++i) {
+      index[live[i].first] = i;
+    }
+    std::vector<std::vector<size_t>> edges(live.size());
+    for (size_t i = 0; i < live.size(); ++i) {
+      const Entry& entry = live[i].second;
+      if (entry.visitEdges == nullptr || entry.sharedCount(live[i].first) == 0) {
+        continue;
+      }
+      SharedEdgeVisitor visitor;
+      entry.visitEdges(entry.object, visitor);
+      for (const void* target : visitor.targets) {
+        auto it = index.find(target);
+        if (it != index.end()) {
+          edges[i].push_back(it->second);
+        }
+      }
+    }
+
+    enum State : char { unvisited, onPath, done };
+    std::vector<State> state(live.size(), unvisited);
+    std::vector<std::vector<uint64_t>> cycles;
+    std::vector<std::pair<size_t, size_t>> path;
+    for (size_t root = 0; root < live.size(); ++root) {
+      if (state[root] != unvisited) {
+        continue;
+      }
+      path.emplace_back(root, 0);
+      state[root] = onPath;
+      while (!path.empty()) {
+        auto& [node, next] = path.back();
+        if (next == edges[node].size()) {
+          state[node] = done;
+          path.pop_back();
+          continue;
+        }
+        size_t target = edges[node][next++];
+        if (state[target] == unvisited) {
+          state[target] = onPath;
+          path.emplace_back(target, 0);
+        } else if (state[target] == onPath) {
+          std::vector<uint64_t> cycle;
+          size_t start = path.size();
+          while (path[start - 1].first != target) {
+            --start;
+          }
+          for (size_t i = start - 1; i < path.size(); ++i) {
+            cycle.push_back(live[path[i].first].second.id);
+          }
+          cycles.push_back(std::move(cycle));
+        }
+      }
+    }
+    return cycles;
+  }
+
+  size_t reportCycles(std::ostream& out) {
+    auto cycles = findCycles();
+    for (const auto& cycle : cycles) {
+      out << "cycle:";
+      for (uint64_t id : cycle) {
+        out << " #" << id;
+      }
+      out << '\n';
+    }
+    return cycles.size();
+  }
+
+  private:
+  struct Location {
+    const char* file;
+    int line;
+  };
+
+  std::mutex mutex;
+  std::unordered_map<const void*, Entry> entries;
+  std::atomic<uint64_t> nextId {1};
+  std::atomic<bool> reportAtExit {true};
+
+  ControlBlockRegistry() = default;
+
+  static Location& current() {
+    thread_local Location location {nullptr, 0};
+    return location;
+  }
+
+  std::vector<std::pair<const void*, Entry>> snapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<const void*, Entry>> result(entries.begin(), entries.end());
+    std::sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.second.id < rhs.second.id;
+    });
+    return result;
+  }
+
+  static void print(std::ostream& out, const void* block, const Entry& entry) {
+    out << "  #" << entry.id << ' ' << entry.type << " object=" << entry.object
+        << " block=" << block << " shared=" << entry.sharedCount(block);
+    if (entry.file != nullptr) {
+      out << " at " << entry.file << ':' << entry.line;
+    }
+    out << '\n';
+  }
+};
+
+#define SMART_POINTERS_TRACE(...) (ControlBlockRegistry::CallSite(__FILE__, __LINE__), (__VA_ARGS__))
+#else
+#define SMART_POINTERS_TRACE(...) (__VA_ARGS__)
+#endif
+
+// countWeak holds one extra reference on behalf of all SharedPtrs, so the
+// block is freed exactly once, by whoever drops countWeak to zero.
+// Instead of a vtable every block stores one manage function that both
+// destroys the object and frees the block.
+template <typename RefCount>
 struct BaseControlBlock {
-  size_t countShared = 0;
-  size_t countWeak = 0;
+  enum class Operation { useDeleter, destroy };
+  using Manager = void (*)(BaseControlBlock*, Operation);
+
+  struct NoLink {};
+
+  RefCount countShared;
+  RefCount countWeak;
+  Manager manage;
+  // Link in the reclaim queue, only present for deferred blocks.
+  [[no_unique_address]] std::conditional_t<isDeferredRefCount<RefCount>, BaseControlBlock*, NoLink> next {};
 
-  BaseControlBlock(size_t count_shared, size_t count_weak)
-    : countShared(count_shared), countWeak(count_weak) {}
+  BaseControlBlock(uint32_t count_shared, uint32_t count_weak, Manager manager)
+    : countShared(count_shared), countWeak(count_weak), manage(manager) {}
+
+  void releaseShared() {
+    if (countShared.decrement()) {
+      if constexpr (isDeferredRefCount<RefCount>) {
+        ReclaimQueue<RefCount>::push(this);
+      } else {
+        reclaim();
+      }
+    }
+  }
 
-  virtual void useDeleter() = 0;
-  virtual void destroy() = 0;
-  virtual ~BaseControlBlock() = default;
+  void reclaim() {
+    manage(this, Operation::useDeleter);
+    releaseWeak();
+  }
+
+  void releaseWeak() {
+    if (countWeak.decrement()) {
+#ifdef SMART_POINTERS_DEBUG
+      ControlBlockRegistry::instance().remove(this);
+#endif
+      manage(this, Operation::destroy);
+    }
+  }
 };
 
-template <typename T, typename Alloc, typename Deleter>
-struct ControlBlockRegular : BaseControlBlock {
+static_assert(sizeof(BaseControlBlock<AtomicRefCount>) == 16);
+static_assert(sizeof(BaseControlBlock<PlainRefCount>) == 16);
+
+template <typename T, typename Alloc, typename Deleter, typename RefCount>
+struct ControlBlockRegular : BaseControlBlock<RefCount> {
+  using Base = BaseControlBlock<RefCount>;
+
   T* ptr;
-  Alloc alloc;
-  Deleter del;
+  [[no_unique_address]] Alloc alloc;
+  [[no_unique_address]] Deleter del;
 
   ControlBlockRegular(T* p, Deleter d, Alloc al)
-    : BaseControlBlock(1, 0), ptr(p), alloc(al), del(d) {}
-
-  void useDeleter() override {
-    del(ptr);
-  }
+    : Base(1, 1, &manageBlock), ptr(p), alloc(al), del(d) {}
 
-  void destroy() override {
+  static void manageBlock(Base* base, typename Base::Operation op) {
+    auto* self = static_cast<ControlBlockRegular*>(base);
+    if (op == Base::Operation::useDeleter) {
+      self->del(self->ptr);
+      return;
+    }
     using AllocType =
       typename std::allocator_traits<Alloc>::template rebind_alloc<
-        ControlBlockRegular<T, Alloc, Deleter>>;
-    AllocType all = alloc;
-    std::allocator_traits<AllocType>::deallocate(all, this, 1);
+        ControlBlockRegular<T, Alloc, Deleter, RefCount>>;
+    AllocType all = self->alloc;
+    self->~ControlBlockRegular();
+    std::allocator_traits<AllocType>::deallocate(all, self, 1);
   }
 };
 
-template <typename T, typename Alloc>
-struct ControlBlockMakeShared : BaseControlBlock {
-  Alloc alloc;
-  T ptr;
+template <typename T, typename Alloc, typename RefCount>
+struct ControlBlockMakeShared : BaseControlBlock<RefCount> {
+  using Base = BaseControlBlock<RefCount>;
+
+  [[no_unique_address]] Alloc alloc;
+  union {
+    T ptr;
+  };
 
   template <typename... Args>
   ControlBlockMakeShared(Alloc al, Args&&... args)
-    : BaseControlBlock(1, 0), alloc(al), ptr(std::forward<Args>(args)...) {}
+    : Base(1, 1, &manageBlock), alloc(al), ptr(std::forward<Args>(args)...) {}
 
-  void useDeleter() override {
-    using AllocType = typename std::allocator_traits<
-      Alloc>::template rebind_alloc<ControlBlockMakeShared<T, Alloc>>;
-    AllocType all = alloc;
-    std::allocator_traits<AllocType>::destroy(all, &ptr);
-  }
+  // ptr is destroyed by useDeleter, not by this destructor.
+  ~ControlBlockMakeShared() {}
 
-  void destroy() override {
+  static void manageBlock(Base* base, typename Base::Operation op) {
+    auto* self = static_cast<ControlBlockMakeShared*>(base);
     using AllocType = typename std::allocator_traits<
-      Alloc>::template rebind_alloc<ControlBlockMakeShared<T, Alloc>>;
-    AllocType all = alloc;
-    std::allocator_traits<AllocType>::deallocate(all, this, 1);
+      Alloc>::template rebind_alloc<ControlBlockMakeShared<T, Alloc, RefCount>>;
+    AllocType all = self->alloc;
+    if (op == Base::Operation::useDeleter) {
+      std::allocator_traits<AllocType>::destroy(all, &self->ptr);
+      return;
+    }
+    self->~ControlBlockMakeShared();
+    std::allocator_traits<AllocType>::deallocate(all, self, 1);
   }
 };
 
@@ -62,19 +422,33 @@ template <typename T, typename U>
 using isBaseOrSame =
   std::enable_if_t<std::is_same_v<T, U> || std::is_base_of_v<T, U>>;
 
-template <typename T>
+template <typename T, typename RefCount>
+class EnableSharedFromThis;
+
+template <typename T, typename RefCount = DefaultRefCount>
 class SharedPtr {
   public:
   SharedPtr() : data(nullptr), ptr(nullptr) {}
 
   template <typename U, typename Deleter, typename Alloc,
     typename = isBaseOrSame<T, U>>
-  SharedPtr(U* p, Deleter d, Alloc alloc)
-    : data(typename std::allocator_traits<Alloc>::template rebind_alloc<
-    ControlBlockRegular<U, Alloc, Deleter>>(alloc)
-             .allocate(1)),
-      ptr(p) {
-    new (data) ControlBlockRegular<U, Alloc, Deleter>(ptr, d, alloc);
+  SharedPtr(U* p, Deleter d, Alloc alloc) : data(nullptr), ptr(p) {
+    using Block = ControlBlockRegular<U, Alloc, Deleter, RefCount>;
+    using AllocType = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    AllocType allocBlock = alloc;
+    Block* block = nullptr;
+    try {
+      block = std::allocator_traits<AllocType>::allocate(allocBlock, 1);
+    } catch (...) {
+      d(p);
+      throw;
+    }
+    new (block) Block(p, std::move(d), alloc);
+    data = block;
+#ifdef SMART_POINTERS_DEBUG
+    ControlBlockRegistry::instance().add(block, p);
+#endif
+    hookSharedFromThis(p, p);
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
@@ -83,14 +457,14 @@ class SharedPtr {
 
   SharedPtr(const SharedPtr& other) : data(other.data), ptr(other.ptr) {
     if (data != nullptr) {
-      ++data->countShared;
+      data->countShared.increment();
     }
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  SharedPtr(const SharedPtr<U>& other) : data(other.data), ptr(other.ptr) {
+  SharedPtr(const SharedPtr<U, RefCount>& other) : data(other.data), ptr(other.ptr) {
     if (data != nullptr) {
-      ++data->countShared;
+      data->countShared.increment();
     }
   }
 
@@ -98,7 +472,7 @@ class SharedPtr {
   SharedPtr(U* p, Deleter d) : SharedPtr(p, d, std::allocator<U>()) {}
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  SharedPtr(SharedPtr<U>&& other) : data(other.data), ptr(other.ptr) {
+  SharedPtr(SharedPtr<U, RefCount>&& other) : data(other.data), ptr(other.ptr) {
     other.ptr = nullptr;
     other.data = nullptr;
   }
@@ -108,37 +482,53 @@ class SharedPtr {
     other.data = nullptr;
   }
 
+  // Aliasing constructors: share ownership with other but point at p.
+  template <typename U>
+  SharedPtr(const SharedPtr<U, RefCount>& other, T* p) : data(other.data), ptr(p) {
+    if (data != nullptr) {
+      data->countShared.increment();
+    }
+  }
+
+  template <typename U>
+  SharedPtr(SharedPtr<U, RefCount>&& other, T* p) : data(other.data), ptr(p) {
+    other.ptr = nullptr;
+    other.data = nullptr;
+  }
+
   template <typename U>
-  SharedPtr<T>& operator=(U&& other) {
-    this->template swap(SharedPtr<T>(std::forward<U>(other)));
+  SharedPtr& operator=(U&& other) {
+    this->template swap(SharedPtr(std::forward<U>(other)));
+    return *this;
+  }
+
+  SharedPtr& operator=(const SharedPtr& other) {
+    this->template swap(SharedPtr(other));
+    return *this;
+  }
+
+  SharedPtr& operator=(SharedPtr&& other) {
+    this->template swap(SharedPtr(std::move(other)));
     return *this;
   }
 
   ~SharedPtr() {
-    if (data == nullptr) {
-      return;
-    }
-    --data->countShared;
-    if (data->countShared > 0) {
-      return;
-    }
-    data->useDeleter();
-    if (data->countWeak == 0) {
-      data->destroy();
+    if (data != nullptr) {
+      data->releaseShared();
     }
   }
 
   size_t use_count() const {
-    return (data != nullptr ? data->countShared : 0);
+    return (data != nullptr ? data->countShared.load() : 0);
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
   void reset(U* other) {
-    (other == nullptr) ? reset() : this->template swap(SharedPtr<T>(other));
+    (other == nullptr) ? reset() : this->template swap(SharedPtr(other));
   }
 
   void reset() {
-    this->template swap(SharedPtr<T>());
+    this->template swap(SharedPtr());
   }
 
   template <typename U>
@@ -160,60 +550,82 @@ class SharedPtr {
   }
 
   private:
-  template <typename U>
+  template <typename U, typename R>
   friend class SharedPtr;
 
-  template <typename U>
+  template <typename U, typename R>
   friend class WeakPtr;
 
-  BaseControlBlock* data;
+  template <typename U>
+  friend class AtomicSharedPtr;
+
+  friend class SharedEdgeVisitor;
+
+  BaseControlBlock<RefCount>* data;
   T* ptr;
 
   template <typename Alloc, typename... Args>
   SharedPtr(Alloc alloc, Args&&... args) {
     using AllocType = typename std::allocator_traits<
-      Alloc>::template rebind_alloc<ControlBlockMakeShared<T, Alloc>>;
+      Alloc>::template rebind_alloc<ControlBlockMakeShared<T, Alloc, RefCount>>;
     AllocType allocMakeShared = alloc;
 
-    auto* pAllocMakeShared = allocMakeShared.allocate(1);
-    std::allocator_traits<AllocType>::construct(
-      allocMakeShared, pAllocMakeShared, alloc,
-      std::forward<Args>(args)...);
+    auto* pAllocMakeShared = std::allocator_traits<AllocType>::allocate(allocMakeShared, 1);
+    try {
+      std::allocator_traits<AllocType>::construct(
+        allocMakeShared, pAllocMakeShared, alloc,
+        std::forward<Args>(args)...);
+    } catch (...) {
+      std::allocator_traits<AllocType>::deallocate(allocMakeShared, pAllocMakeShared, 1);
+      throw;
+    }
     data = pAllocMakeShared;
-    ptr = nullptr;
+    ptr = &pAllocMakeShared->ptr;
+#ifdef SMART_POINTERS_DEBUG
+    ControlBlockRegistry::instance().add(data, ptr);
+#endif
+    hookSharedFromThis(ptr, ptr);
   }
 
-  SharedPtr(T* p, BaseControlBlock* counter) : data(counter), ptr(p) {
-    ++counter->countShared;
+  template <typename U, typename Base>
+  void hookSharedFromThis(U* p, const EnableSharedFromThis<Base, RefCount>* base) {
+    if (base->weakThis.use_count() == 0) {
+      base->weakThis = SharedPtr<Base, RefCount>(*this, static_cast<Base*>(p));
+    }
   }
 
-  template <typename U, typename... Args>
-  friend SharedPtr<U> makeShared(Args&&... args);
+  void hookSharedFromThis(...) {}
+
+  // Adopts a reference the caller already holds.
+  SharedPtr(T* p, BaseControlBlock<RefCount>* counter) : data(counter), ptr(p) {}
+
+  template <typename U, typename R, typename... Args>
+  friend SharedPtr<U, R> makeShared(Args&&... args);
 
-  template <typename U, typename Alloc, typename... Args>
-  friend SharedPtr<U> allocateShared(const Alloc&, Args&&...);
+  template <typename U, typename R, typename Alloc, typename... Args>
+  friend SharedPtr<U, R> allocateShared(const Alloc&, Args&&...);
 };
 
-template <typename T>
+template <typename T, typename RefCount = DefaultRefCount>
 class WeakPtr {
   public:
   WeakPtr() : data(nullptr), ptr(nullptr) {}
 
   WeakPtr(const WeakPtr& other) : data(other.data), ptr(other.ptr) {
     if (data != nullptr) {
-      ++data->countWeak;
+      data->countWeak.increment();
     }
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  WeakPtr(const WeakPtr<U>& other) : data(other.data), ptr(other.ptr) {
+  WeakPtr(const WeakPtr<U, RefCount>& other) : data(other.data), ptr(other.ptr) {
     if (data != nullptr) {
-      ++data->countWeak;
+      data->countWeak.increment();
     }
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  WeakPtr(WeakPtr<U>&& other) : data(other.data), ptr(other.ptr) {
+  WeakPtr(WeakPtr<U, RefCount>&& other) : data(other.data), ptr(other.ptr) {
     other.ptr = nullptr;
     other.data = nullptr;
   }
@@ -224,36 +636,42 @@ class WeakPtr {
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  WeakPtr(const SharedPtr<U>& other) : data(other.data), ptr(other.ptr) {
+  WeakPtr(const SharedPtr<U, RefCount>& other) : data(other.data), ptr(other.ptr) {
     if (data != nullptr) {
-      ++data->countWeak;
+      data->countWeak.increment();
     }
   }
 
   ~WeakPtr() {
-    if (data == nullptr) {
-      return;
-    }
-    --data->countWeak;
-    if (data->countWeak == 0 && data->countShared == 0) {
-      data->destroy();
+    if (data != nullptr) {
+      data->releaseWeak();
     }
   }
 
   template <typename U, typename = isBaseOrSame<T, U>>
-  WeakPtr<T>& operator=(const SharedPtr<U>& other) {
-    this->swap(WeakPtr<T>(other));
+  WeakPtr& operator=(const SharedPtr<U, RefCount>& other) {
+    this->swap(WeakPtr(other));
     return *this;
   }
 
   template <typename Other>
-  WeakPtr<T>& operator=(Other&& other) {
-    this->swap(WeakPtr<T>(std::forward<Other>(other)));
+  WeakPtr& operator=(Other&& other) {
+    this->swap(WeakPtr(std::forward<Other>(other)));
+    return *this;
+  }
+
+  WeakPtr& operator=(const WeakPtr& other) {
+    this->swap(WeakPtr(other));
+    return *this;
+  }
+
+  WeakPtr& operator=(WeakPtr&& other) {
+    this->swap(WeakPtr(std::move(other)));
     return *this;
   }
 
   size_t use_count() const {
-    return (data != nullptr ? data->countShared : 0);
+    return (data != nullptr ? data->countShared.load() : 0);
   }
 
   template <class U>
@@ -274,31 +692,511 @@ class WeakPtr {
     return ptr;
   }
 
-  SharedPtr<T> lock() const {
-    return expired() ? SharedPtr<T>() : SharedPtr<T>(ptr, data);
+  SharedPtr<T, RefCount> lock() const {
+    if (data == nullptr || !data->countShared.incrementIfNotZero()) {
+      return SharedPtr<T, RefCount>();
+    }
+    return SharedPtr<T, RefCount>(ptr, data);
   }
 
   bool expired() const {
-    return data->countShared == 0;
+    return data == nullptr || data->countShared.load() == 0;
   }
 
   private:
-  template <typename U>
+  template <typename U, typename R>
   friend class WeakPtr;
 
-  template <typename U>
+  template <typename U, typename R>
+  friend class SharedPtr;
+
+  BaseControlBlock<RefCount>* data;
+  T* ptr;
+};
+
+template <typename T, typename RefCount = DefaultRefCount, typename... Args>
+SharedPtr<T, RefCount> makeShared(Args&&... args) {
+  return SharedPtr<T, RefCount>(std::allocator<T>(), std::forward<Args>(args)...);
+}
+
+template <typename T, typename RefCount = DefaultRefCount, typename Alloc, typename... Args>
+SharedPtr<T, RefCount> allocateShared(const Alloc& alloc, Args&&... args) {
+  return SharedPtr<T, RefCount>(alloc, std::forward<Args>(args)...);
+}
+
+template <typename T, typename RefCount = DefaultRefCount>
+class EnableSharedFromThis {
+  public:
+  SharedPtr<T, RefCount> sharedFromThis() {
+    return weakThis.lock();
+  }
+
+  SharedPtr<const T, RefCount> sharedFromThis() const {
+    return weakThis.lock();
+  }
+
+  WeakPtr<T, RefCount> weakFromThis() const {
+    return weakThis;
+  }
+
+  protected:
+  EnableSharedFromThis() = default;
+  EnableSharedFromThis(const EnableSharedFromThis&) {}
+
+  EnableSharedFromThis& operator=(const EnableSharedFromThis&) {
+    return *this;
+  }
+
+  ~EnableSharedFromThis() = default;
+
+  private:
+  template <typename U, typename R>
   friend class SharedPtr;
 
-  BaseControlBlock* data;
+  mutable WeakPtr<T, RefCount> weakThis;
+};
+
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> staticPointerCast(const SharedPtr<U, RefCount>& p) {
+  return SharedPtr<T, RefCount>(p, static_cast<T*>(p.get()));
+}
+
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> staticPointerCast(SharedPtr<U, RefCount>&& p) {
+  T* cast = static_cast<T*>(p.get());
+  return SharedPtr<T, RefCount>(std::move(p), cast);
+}
+
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> dynamicPointerCast(const SharedPtr<U, RefCount>& p) {
+  T* cast = dynamic_cast<T*>(p.get());
+  return (cast != nullptr ? SharedPtr<T, RefCount>(p, cast) : SharedPtr<T, RefCount>());
+}
+
+// Leaves p untouched when the cast fails.
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> dynamicPointerCast(SharedPtr<U, RefCount>&& p) {
+  T* cast = dynamic_cast<T*>(p.get());
+  return (cast != nullptr ? SharedPtr<T, RefCount>(std::move(p), cast) : SharedPtr<T, RefCount>());
+}
+
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> constPointerCast(const SharedPtr<U, RefCount>& p) {
+  return SharedPtr<T, RefCount>(p, const_cast<T*>(p.get()));
+}
+
+template <typename T, typename U, typename RefCount>
+SharedPtr<T, RefCount> constPointerCast(SharedPtr<U, RefCount>&& p) {
+  T* cast = const_cast<T*>(p.get());
+  return SharedPtr<T, RefCount>(std::move(p), cast);
+}
+
+// Lock-free atomic SharedPtr using split reference counts. The stored word packs
+// a pointer to a node (a control block owning a SharedPtr copy) with a 16-bit
+// local count in the top bits. Readers bump the local count to pin the node,
+// copy its SharedPtr and hand the local reference back. A writer first takes
+// its own shared reference on the current node, then moves the local count
+// into the node's shared count before replacing the word, so readers that
+// lose the race release a shared reference instead.
+template <typename T>
+class AtomicSharedPtr {
+  public:
+  AtomicSharedPtr() : word(0) {}
+
+  AtomicSharedPtr(SharedPtr<T> desired) : word(pack(makeNode(std::move(desired)))) {}
+
+  AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+  AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+  ~AtomicSharedPtr() {
+    if (Node* node = unpack(word.load(std::memory_order_acquire))) {
+      node->releaseShared();
+    }
+  }
+
+  AtomicSharedPtr& operator=(SharedPtr<T> desired) {
+    store(std::move(desired));
+    return *this;
+  }
+
+  operator SharedPtr<T>() const {
+    return load();
+  }
+
+  bool is_lock_free() const {
+    return word.is_lock_free();
+  }
+
+  SharedPtr<T> load() const {
+    uint64_t current = word.fetch_add(LOCAL_ONE, std::memory_order_acquire) + LOCAL_ONE;
+    Node* node = unpack(current);
+    if (node == nullptr) {
+      return SharedPtr<T>();
+    }
+    SharedPtr<T> result = node->ptr;
+    returnLocal(node, current);
+    return result;
+  }
+
+  void store(SharedPtr<T> desired) {
+    Node* fresh = makeNode(std::move(desired));
+    while (true) {
+      Node* current = acquire();
+      bool replaced = replaceIf(current, fresh);
+      release(current);
+      if (replaced) {
+        return;
+      }
+    }
+  }
+
+  SharedPtr<T> exchange(SharedPtr<T> desired) {
+    Node* fresh = makeNode(std::move(desired));
+    while (true) {
+      Node* current = acquire();
+      if (replaceIf(current, fresh)) {
+        SharedPtr<T> result = (current != nullptr ? current->ptr : SharedPtr<T>());
+        release(current);
+        return result;
+      }
+      release(current);
+    }
+  }
+
+  // On failure, expected receives the current value.
+  bool compare_exchange(SharedPtr<T>& expected, SharedPtr<T> desired) {
+    Node* fresh = makeNode(std::move(desired));
+    while (true) {
+      Node* current = acquire();
+      if (!holds(current, expected)) {
+        expected = (current != nullptr ? current->ptr : SharedPtr<T>());
+        release(current);
+        release(fresh);
+        return false;
+      }
+      bool replaced = replaceIf(current, fresh);
+      release(current);
+      if (replaced) {
+        return true;
+      }
+    }
+  }
+
+  private:
+  using Node = ControlBlockMakeShared<SharedPtr<T>, std::allocator<SharedPtr<T>>, AtomicRefCount>;
+
+  static_assert(sizeof(void*) == 8, "AtomicSharedPtr packs a 48-bit pointer into a 64-bit word");
+
+  static constexpr int LOCAL_SHIFT = 48;
+  static constexpr uint64_t LOCAL_ONE = uint64_t(1) << LOCAL_SHIFT;
+  static constexpr uint64_t POINTER_MASK = LOCAL_ONE - 1;
+
+  mutable std::atomic<uint64_t> word;
+
+  static uint64_t pack(Node* node) {
+    return reinterpret_cast<uint64_t>(node);
+  }
+
+  static Node* unpack(uint64_t value) {
+    return reinterpret_cast<Node*>(value & POINTER_MASK);
+  }
+
+  static uint32_t local(uint64_t value) {
+    return value >> LOCAL_SHIFT;
+  }
+
+  static Node* makeNode(SharedPtr<T>&& value) {
+    if (value.data == nullptr) {
+      return nullptr;
+    }
+    using AllocType = std::allocator<Node>;
+    AllocType alloc;
+    Node* node = std::allocator_traits<AllocType>::allocate(alloc, 1);
+    std::allocator_traits<AllocType>::construct(alloc, node, std::allocator<SharedPtr<T>>(), std::move(value));
+    return node;
+  }
+
+  static void release(Node* node) {
+    if (node != nullptr) {
+      node->releaseShared();
+    }
+  }
+
+  static bool holds(Node* node, const SharedPtr<T>& expected) {
+    if (node == nullptr) {
+      return expected.data == nullptr;
+    }
+    return node->ptr.data == expected.data && node->ptr.ptr == expected.ptr;
+  }
+
+  // Gives back a local reference taken on node. If a writer already replaced
+  // the word, the reference was moved into the shared count and is dropped there.
+  void returnLocal(Node* node, uint64_t current) const {
+    while (unpack(current) == node) {
+      if (word.compare_exchange_weak(current, current - LOCAL_ONE, std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    node->releaseShared();
+  }
+
+  // Returns the current node with a shared reference held by the caller.
+  Node* acquire() const {
+    uint64_t current = word.fetch_add(LOCAL_ONE, std::memory_order_acquire) + LOCAL_ONE;
+    Node* node = unpack(current);
+    if (node != nullptr) {
+      node->countShared.increment();
+      returnLocal(node, current);
+    }
+    return node;
+  }
+
+  // The caller must hold a shared reference on unpack(current): the pinned
+  // readers are moved into its count before the word is swapped.
+  bool tryReplace(uint64_t& current, Node* fresh) {
+    Node* old = unpack(current);
+    uint32_t pinned = local(current);
+    if (old != nullptr && pinned != 0) {
+      old->countShared.increment(pinned);
+    }
+    if (word.compare_exchange_weak(current, pack(fresh), std::memory_order_acq_rel,
+                                   std::memory_order_acquire)) {
+      return true;
+    }
+    if (old != nullptr && pinned != 0) {
+      old->countShared.decrement(pinned);
+    }
+    return false;
+  }
+
+  // Replaces expected, which the caller holds a reference on, and drops the
+  // word's reference to it.
+  bool replaceIf(Node* expected, Node* fresh) {
+    uint64_t current = word.load(std::memory_order_acquire);
+    while (unpack(current) == expected) {
+      if (tryReplace(current, fresh)) {
+        release(expected);
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+// Base for intrusively counted types. IntrusivePtr finds the hooks below
+// through ADL, so any type can opt in by providing its own
+// intrusiveAddRef/intrusiveRelease/intrusiveUseCount overloads instead.
+template <typename Derived, typename RefCount = DefaultRefCount>
+class RefCounted {
+  public:
+  RefCounted() : refs(0) {}
+  RefCounted(const RefCounted&) : refs(0) {}
+
+  RefCounted& operator=(const RefCounted&) {
+    return *this;
+  }
+
+  protected:
+  ~RefCounted() = default;
+
+  private:
+  mutable RefCount refs;
+
+  friend void intrusiveAddRef(const RefCounted* p) {
+    p->refs.increment();
+  }
+
+  friend void intrusiveRelease(const RefCounted* p) {
+    if (p->refs.decrement()) {
+      delete static_cast<const Derived*>(p);
+    }
+  }
+
+  friend size_t intrusiveUseCount(const RefCounted* p) {
+    return p->refs.load();
+  }
+};
+
+template <typename T>
+class IntrusivePtr {
+  public:
+  IntrusivePtr() : ptr(nullptr) {}
+
+  IntrusivePtr(T* p, bool addRef = true) : ptr(p) {
+    if (ptr != nullptr && addRef) {
+      intrusiveAddRef(ptr);
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr& other) : IntrusivePtr(other.ptr) {}
+
+  template <typename U, typename = isBaseOrSame<T, U>>
+  IntrusivePtr(const IntrusivePtr<U>& other) : IntrusivePtr(other.get()) {}
+
+  IntrusivePtr(IntrusivePtr&& other) : ptr(other.ptr) {
+    other.ptr = nullptr;
+  }
+
+  template <typename U, typename = isBaseOrSame<T, U>>
+  IntrusivePtr(IntrusivePtr<U>&& other) : ptr(other.detach()) {}
+
+  template <typename U>
+  IntrusivePtr& operator=(U&& other) {
+    swap(IntrusivePtr(std::forward<U>(other)));
+    return *this;
+  }
+
+  IntrusivePtr& operator=(const IntrusivePtr& other) {
+    swap(IntrusivePtr(other));
+    return *this;
+  }
+
+  IntrusivePtr& operator=(IntrusivePtr&& other) {
+    swap(IntrusivePtr(std::move(other)));
+    return *this;
+  }
+
+  ~IntrusivePtr() {
+    if (ptr != nullptr) {
+      intrusiveRelease(ptr);
+    }
+  }
+
+  size_t use_count() const {
+    return (ptr != nullptr ? intrusiveUseCount(ptr) : 0);
+  }
+
+  void reset(T* other = nullptr) {
+    swap(IntrusivePtr(other));
+  }
+
+  // Gives up ownership without touching the count.
+  T* detach() {
+    T* result = ptr;
+    ptr = nullptr;
+    return result;
+  }
+
+  template <typename U>
+  void swap(U&& other) {
+    std::swap(ptr, other.ptr);
+  }
+
+  T* get() const {
+    return ptr;
+  }
+
+  T& operator*() const {
+    return *ptr;
+  }
+
+  T* operator->() const {
+    return ptr;
+  }
+
+  private:
   T* ptr;
 };
 
 template <typename T, typename... Args>
-SharedPtr<T> makeShared(Args&&... args) {
-  return SharedPtr<T>(std::allocator<T>(), std::forward<Args>(args)...);
+IntrusivePtr<T> makeIntrusive(Args&&... args) {
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
 }
 
-template <typename T, typename Alloc, typename... Args>
-SharedPtr<T> allocateShared(const Alloc& alloc, Args&&... args) {
-  return SharedPtr<T>(alloc, std::forward<Args>(args)...);
+struct IntrusiveReleaser {
+  template <typename T>
+  void operator()(T* p) const {
+    intrusiveRelease(p);
+  }
+};
+
+// The SharedPtr keeps one intrusive reference for as long as it or its copies live.
+template <typename T, typename RefCount = DefaultRefCount>
+SharedPtr<T, RefCount> sharedFromIntrusive(IntrusivePtr<T> p) {
+  if (p.get() == nullptr) {
+    return SharedPtr<T, RefCount>();
+  }
+  return SharedPtr<T, RefCount>(p.detach(), IntrusiveReleaser());
 }
+
+// Lock-free stack of deferred blocks whose last SharedPtr is gone. Objects
+// destroyed by drain() push their own deferred members back onto the queue
+// instead of recursing, so long chains are torn down iteratively.
+template <>
+class ReclaimQueue<DeferredRefCount> {
+  public:
+  using Block = BaseControlBlock<DeferredRefCount>;
+
+  static void push(Block* block) {
+    pushChain(block, block);
+  }
+
+  // Destroys up to limit pending objects and returns how many were destroyed.
+  static size_t drain(size_t limit = SIZE_MAX) {
+    size_t done = 0;
+    while (done < limit) {
+      Block* batch = head.exchange(nullptr, std::memory_order_acquire);
+      if (batch == nullptr) {
+        break;
+      }
+      while (batch != nullptr) {
+        if (done == limit) {
+          Block* tail = batch;
+          while (tail->next != nullptr) {
+            tail = tail->next;
+          }
+          pushChain(batch, tail);
+          return done;
+        }
+        Block* next = batch->next;
+        batch->reclaim();
+        ++done;
+        batch = next;
+      }
+    }
+    return done;
+  }
+
+  static bool empty() {
+    return head.load(std::memory_order_relaxed) == nullptr;
+  }
+
+  private:
+  static inline std::atomic<Block*> head {nullptr};
+
+  static void pushChain(Block* first, Block* last) {
+    Block* current = head.load(std::memory_order_relaxed);
+    do {
+      last->next = current;
+    } while (!head.compare_exchange_weak(current, first, std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+};
+
+// Drains ReclaimQueue<DeferredRefCount> on its own thread until destroyed.
+class BackgroundReclaimer {
+  public:
+  explicit BackgroundReclaimer(std::chrono::microseconds interval = std::chrono::milliseconds(1),
+                               size_t batch = 1024)
+    : worker([this, interval, batch] {
+        while (!stopping.load(std::memory_order_acquire)) {
+          if (ReclaimQueue<DeferredRefCount>::drain(batch) < batch) {
+            std::this_thread::sleep_for(interval);
+          }
+        }
+      }) {}
+
+  BackgroundReclaimer(const BackgroundReclaimer&) = delete;
+  BackgroundReclaimer& operator=(const BackgroundReclaimer&) = delete;
+
+  ~BackgroundReclaimer() {
+    stopping.store(true, std::memory_order_release);
+    worker.join();
+    ReclaimQueue<DeferredRefCount>::drain();
+  }
+
+  private:
+  std::atomic<bool> stopping {false};
+  std::thread worker;
+};
@@ -1,22 +1,272 @@
 #include <iostream>
+#include <algorithm>
+#include <new>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <functional>
+#include <map>
+#include <source_location>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 template <size_t N>
 class StackStorage {
   private:
+  struct Block {
+    Block* prev;
+    size_t size;
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+  };
+
   char data_first[N];
   size_t shift = 0;
+  char* region = data_first;
+  size_t region_size = N;
+  Block* blocks = nullptr;
+  // Blocks given back by rollback, linked through prev and kept until the
+  // storage dies, so repeated mark/rollback frames stop touching the heap.
+  Block* spares = nullptr;
+  bool growable = true;
+  size_t used_ = 0;
+  size_t high_water_mark_ = 0;
+  size_t heap_bytes_ = 0;
+  size_t overflow_count_ = 0;
+
+  static size_t padding(const char* ptr, const size_t alignof_) {
+    return (alignof_ - (reinterpret_cast<size_t>(ptr) % alignof_)) % alignof_;
+  }
+
+  // Unlinks the smallest spare of at least size bytes, if any.
+  Block* take_spare(size_t size) {
+    Block** best = nullptr;
+    for (Block** link = &spares; *link != nullptr; link = &(*link)->prev) {
+      if ((*link)->size >= size && (best == nullptr || (*link)->size < (*best)->size)) {
+        best = link;
+      }
+    }
+    if (best == nullptr) {
+      return nullptr;
+    }
+    Block* block = *best;
+    *best = block->prev;
+    return block;
+  }
+
+  void grow(size_t n) {
+    if (!growable) {
+      throw std::bad_alloc();
+    }
+    size_t size = std::max(n, 2 * region_size);
+    Block* block = take_spare(size);
+    if (block == nullptr) {
+      block = static_cast<Block*>(::operator new(sizeof(Block) + size));
+      block->size = size;
+      heap_bytes_ += size;
+      ++overflow_count_;
+    }
+    block->prev = blocks;
+    blocks = block;
+    region = block->data();
+    region_size = block->size;
+    shift = 0;
+  }
+
+  void release(Block* block) {
+    block->prev = spares;
+    spares = block;
+  }
 
   public:
+  struct Marker {
+    Block* block;
+    size_t shift;
+    size_t used;
+  };
+
   StackStorage() {}
+  explicit StackStorage(bool growable_storage) : growable(growable_storage) {}
   StackStorage(const StackStorage&) = delete;
   StackStorage& operator=(const StackStorage&) = delete;
 
+  ~StackStorage() {
+    reset();
+    while (spares != nullptr) {
+      Block* prev = spares->prev;
+      ::operator delete(spares);
+      spares = prev;
+    }
+  }
+
   char* allocate(size_t n, const size_t alignof_) {
-    shift += (alignof_ - (reinterpret_cast<size_t>(data_first + shift) % alignof_)) % alignof_;
-    char* data_second_copy = data_first + shift;
-    shift += n;
+    size_t pad = padding(region + shift, alignof_);
+    if (shift + pad + n > region_size) {
+      grow(n + alignof_);
+      pad = padding(region, alignof_);
+    }
+    char* data_second_copy = region + shift + pad;
+    shift += pad + n;
+    used_ += pad + n;
+    high_water_mark_ = std::max(high_water_mark_, used_);
     return data_second_copy;
   }
+
+  void deallocate(char* ptr, size_t n) {
+    if (ptr + n == region + shift && ptr >= region) {
+      shift -= n;
+      used_ -= n;
+    }
+  }
+
+  Marker mark() const { return Marker{blocks, shift, used_}; }
+
+  void rollback(const Marker& marker) {
+    while (blocks != marker.block) {
+      Block* prev = blocks->prev;
+      release(blocks);
+      blocks = prev;
+    }
+    region = (blocks == nullptr ? data_first : blocks->data());
+    region_size = (blocks == nullptr ? N : blocks->size);
+    shift = marker.shift;
+    used_ = marker.used;
+  }
+
+  void reset() { rollback(Marker{nullptr, 0, 0}); }
+
+  size_t used() const { return used_; }
+
+  size_t high_water_mark() const { return high_water_mark_; }
+
+  size_t capacity() const { return N + heap_bytes_; }
+
+  size_t overflow_count() const { return overflow_count_; }
+
+  bool overflowed() const { return overflow_count_ != 0; }
+};
+
+template <size_t N>
+class AtomicStackStorage {
+  private:
+  // Overflow blocks double in size like StackStorage's. Threads bump the
+  // newest block's shift and race with a CAS on current to install the next.
+  struct alignas(std::max_align_t) Block {
+    Block* prev;
+    size_t size;
+    std::atomic<size_t> shift{0};
+
+    Block(Block* previous, size_t block_size) : prev(previous), size(block_size) {}
+
+    char* data() { return reinterpret_cast<char*>(this + 1); }
+  };
+
+  alignas(std::max_align_t) char data_first[N];
+  std::atomic<size_t> shift{0};
+  std::atomic<Block*> current{nullptr};
+  std::atomic<size_t> heap_bytes_{0};
+  std::atomic<size_t> overflow_count_{0};
+
+  static char* bump(std::atomic<size_t>& top, char* region, size_t region_size, size_t n, const size_t alignof_) {
+    size_t old_shift = top.load(std::memory_order_acquire);
+    size_t new_shift;
+    do {
+      size_t pad = (alignof_ - (reinterpret_cast<size_t>(region + old_shift) % alignof_)) % alignof_;
+      new_shift = old_shift + pad + n;
+      if (new_shift > region_size) {
+        return nullptr;
+      }
+    } while (!top.compare_exchange_weak(old_shift, new_shift, std::memory_order_acq_rel,
+                                        std::memory_order_acquire));
+    return region + new_shift - n;
+  }
+
+  // Installs a block after seen, or returns the one another thread installed first.
+  Block* grow(Block* seen, size_t n) {
+    size_t size = std::max(n, 2 * (seen == nullptr ? N : seen->size));
+    Block* block = new (::operator new(sizeof(Block) + size)) Block(seen, size);
+    if (current.compare_exchange_strong(seen, block, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      heap_bytes_.fetch_add(size, std::memory_order_relaxed);
+      overflow_count_.fetch_add(1, std::memory_order_relaxed);
+      return block;
+    }
+    block->~Block();
+    ::operator delete(block);
+    return seen;
+  }
+
+  public:
+  AtomicStackStorage() {}
+  AtomicStackStorage(const AtomicStackStorage&) = delete;
+  AtomicStackStorage& operator=(const AtomicStackStorage&) = delete;
+
+  ~AtomicStackStorage() { reset(); }
+
+  char* allocate(size_t n, const size_t alignof_) {
+    Block* block = current.load(std::memory_order_acquire);
+    while (true) {
+      char* ptr = (block == nullptr ? bump(shift, data_first, N, n, alignof_)
+                                    : bump(block->shift, block->data(), block->size, n, alignof_));
+      if (ptr != nullptr) {
+        return ptr;
+      }
+      block = grow(block, n + alignof_);
+    }
+  }
+
+  // Only the most recent allocation of the inline buffer or the newest block is reclaimed.
+  void deallocate(char* ptr, size_t n) {
+    Block* block = current.load(std::memory_order_acquire);
+    char* region = (block == nullptr ? data_first : block->data());
+    size_t region_size = (block == nullptr ? N : block->size);
+    if (ptr < region || ptr >= region + region_size) {
+      return;
+    }
+    size_t top = ptr - region + n;
+    // Release pairs with the acquire in bump, so the next owner of these bytes sees our writes.
+    (block == nullptr ? shift : block->shift).compare_exchange_strong(top, top - n, std::memory_order_release,
+                                                                      std::memory_order_relaxed);
+  }
+
+  // Approximate while other threads allocate.
+  size_t used() const {
+    size_t total = shift.load(std::memory_order_relaxed);
+    for (Block* block = current.load(std::memory_order_acquire); block != nullptr; block = block->prev) {
+      total += block->shift.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  size_t capacity() const { return N + heap_bytes_.load(std::memory_order_relaxed); }
+
+  size_t overflow_count() const { return overflow_count_.load(std::memory_order_relaxed); }
+
+  bool overflowed() const { return overflow_count() != 0; }
+
+  // Not thread-safe: no other thread may use the storage during reset.
+  void reset() {
+    Block* block = current.exchange(nullptr, std::memory_order_acquire);
+    while (block != nullptr) {
+      Block* prev = block->prev;
+      block->~Block();
+      ::operator delete(block);
+      block = prev;
+    }
+    shift.store(0, std::memory_order_relaxed);
+    heap_bytes_.store(0, std::memory_order_relaxed);
+  }
+};
+
+template <size_t N>
+class ThreadLocalArena {
+  public:
+  static StackStorage<N>& local() {
+    thread_local StackStorage<N> storage;
+    return storage;
+  }
+
+  static void reset() { local().reset(); }
 };
 
 template <typename T, size_t N>
@@ -48,7 +298,9 @@ class StackAllocator {
     return reinterpret_cast<T*>(storage->allocate(n * sizeof(T), alignof(T)));
   }
 
-  void deallocate(T* const, size_t const) {}
+  void deallocate(T* const ptr, size_t const n) {
+    storage->deallocate(reinterpret_cast<char*>(ptr), n * sizeof(T));
+  }
 
   template <typename U, size_t M>
   bool operator==(StackAllocator<U, M> const& other_alloc) const {
@@ -61,6 +313,501 @@ class StackAllocator {
   }
 };
 
+template <typename T, size_t N>
+class AtomicStackAllocator {
+  private:
+  template <typename U, size_t M> friend class AtomicStackAllocator;
+  AtomicStackStorage<N>* storage {};
+
+  public:
+  using value_type = T;
+
+  template <typename U> struct rebind {typedef AtomicStackAllocator<U, N> other; };
+
+  AtomicStackAllocator() = default;
+  ~AtomicStackAllocator() = default;
+
+  AtomicStackAllocator(AtomicStackStorage<N>& other_storage) : storage(&other_storage) {}
+
+  template <typename U>
+  AtomicStackAllocator(const AtomicStackAllocator<U, N>& other) : storage(other.storage) {}
+
+  T* allocate(size_t const n) {
+    return reinterpret_cast<T*>(storage->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* const ptr, size_t const n) {
+    storage->deallocate(reinterpret_cast<char*>(ptr), n * sizeof(T));
+  }
+
+  template <typename U, size_t M>
+  bool operator==(AtomicStackAllocator<U, M> const& other_alloc) const {
+    return storage == other_alloc.storage;
+  }
+
+  template <typename U, size_t M>
+  bool operator!=(AtomicStackAllocator<U, M> const& other_alloc) const {
+    return !(*this == other_alloc);
+  }
+};
+
+template <typename T, size_t N>
+class ThreadLocalAllocator {
+  public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template <typename U> struct rebind {typedef ThreadLocalAllocator<U, N> other; };
+
+  ThreadLocalAllocator() = default;
+
+  template <typename U>
+  ThreadLocalAllocator(const ThreadLocalAllocator<U, N>&) {}
+
+  T* allocate(size_t const n) {
+    return reinterpret_cast<T*>(ThreadLocalArena<N>::local().allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* const ptr, size_t const n) {
+    ThreadLocalArena<N>::local().deallocate(reinterpret_cast<char*>(ptr), n * sizeof(T));
+  }
+
+  template <typename U>
+  bool operator==(ThreadLocalAllocator<U, N> const&) const { return true; }
+
+  template <typename U>
+  bool operator!=(ThreadLocalAllocator<U, N> const&) const { return false; }
+};
+
+template <size_t Size, size_t Align, size_t ChunkNodes>
+class NodePool {
+  private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  static constexpr size_t SLOT_ALIGN = std::max(Align, alignof(FreeNode));
+  static constexpr size_t SLOT_SIZE = (std::max(Size, sizeof(FreeNode)) + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+
+  struct Central {
+    std::mutex mutex;
+    FreeNode* free = nullptr;
+    FreeNode* chunks = nullptr;
+    size_t outstanding = 0;
+
+    ~Central() {
+      if (outstanding != 0) {
+        return;
+      }
+      while (chunks != nullptr) {
+        FreeNode* next = chunks->next;
+        ::operator delete(chunks, std::align_val_t(SLOT_ALIGN));
+        chunks = next;
+      }
+    }
+
+    void carve() {
+      char* memory = static_cast<char*>(::operator new(SLOT_SIZE * (ChunkNodes + 1), std::align_val_t(SLOT_ALIGN)));
+      FreeNode* chunk = reinterpret_cast<FreeNode*>(memory);
+      chunk->next = chunks;
+      chunks = chunk;
+      for (size_t i = ChunkNodes; i > 0; --i) {
+        FreeNode* node = reinterpret_cast<FreeNode*>(memory + i * SLOT_SIZE);
+        node->next = free;
+        free = node;
+      }
+    }
+
+    FreeNode* take(size_t count) {
+      std::lock_guard<std::mutex> lock(mutex);
+      FreeNode* head = nullptr;
+      for (size_t i = 0; i < count; ++i) {
+        if (free == nullptr) {
+          carve();
+        }
+        FreeNode* node = free;
+        free = node->next;
+        node->next = head;
+        head = node;
+      }
+      outstanding += count;
+      return head;
+    }
+
+    void give(FreeNode* head, size_t count) {
+      std::lock_guard<std::mutex> lock(mutex);
+      while (head != nullptr) {
+        FreeNode* next = head->next;
+        head->next = free;
+        free = head;
+        head = next;
+      }
+      outstanding -= count;
+    }
+  };
+
+  struct Cache {
+    FreeNode* free = nullptr;
+    size_t count = 0;
+
+    ~Cache() { central().give(free, count); }
+  };
+
+  static Central& central() {
+    static Central pool;
+    return pool;
+  }
+
+  static Cache& cache() {
+    thread_local Cache pool;
+    return pool;
+  }
+
+  public:
+  template <bool ThreadCache>
+  static void* allocate() {
+    if (!ThreadCache) {
+      return central().take(1);
+    }
+    Cache& local = cache();
+    if (local.free == nullptr) {
+      local.free = central().take(ChunkNodes);
+      local.count = ChunkNodes;
+    }
+    FreeNode* node = local.free;
+    local.free = node->next;
+    --local.count;
+    return node;
+  }
+
+  template <bool ThreadCache>
+  static void deallocate(void* ptr) {
+    FreeNode* node = static_cast<FreeNode*>(ptr);
+    if (!ThreadCache) {
+      node->next = nullptr;
+      central().give(node, 1);
+      return;
+    }
+    Cache& local = cache();
+    node->next = local.free;
+    local.free = node;
+    if (++local.count < 2 * ChunkNodes) {
+      return;
+    }
+    FreeNode* tail = local.free;
+    for (size_t i = 1; i < ChunkNodes; ++i) {
+      tail = tail->next;
+    }
+    FreeNode* head = local.free;
+    local.free = tail->next;
+    tail->next = nullptr;
+    local.count -= ChunkNodes;
+    central().give(head, ChunkNodes);
+  }
+};
+
+template <typename T, size_t ChunkNodes = 64, bool ThreadCache = true>
+class PoolAllocator {
+  private:
+  using Pool = NodePool<sizeof(T), alignof(T), ChunkNodes>;
+
+  public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  template <typename U> struct rebind {typedef PoolAllocator<U, ChunkNodes, ThreadCache> other; };
+
+  PoolAllocator() = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U, ChunkNodes, ThreadCache>&) {}
+
+  T* allocate(size_t const n) {
+    if (n == 1) {
+      return static_cast<T*>(Pool::template allocate<ThreadCache>());
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+  }
+
+  void deallocate(T* const ptr, size_t const n) {
+    if (n == 1) {
+      Pool::template deallocate<ThreadCache>(ptr);
+      return;
+    }
+    ::operator delete(ptr, std::align_val_t(alignof(T)));
+  }
+
+  template <typename U>
+  bool operator==(PoolAllocator<U, ChunkNodes, ThreadCache> const&) const { return true; }
+
+  template <typename U>
+  bool operator!=(PoolAllocator<U, ChunkNodes, ThreadCache> const&) const { return false; }
+};
+
+#ifndef ALLOCATION_TRACING
+#define ALLOCATION_TRACING 1
+#endif
+
+// Attributes every traced allocation made on this thread while it is alive to the place it was declared.
+// Allocator calls arrive through allocator_traits and container internals, so the call site has to be
+// named by the caller: put `AllocationSite site;` in the scope whose allocations should be grouped.
+// Sites nest; the innermost one wins.
+class AllocationSite {
+  private:
+  static inline thread_local const AllocationSite* current_ = nullptr;
+  std::source_location location_;
+  const AllocationSite* previous_;
+
+  public:
+  explicit AllocationSite(std::source_location location = std::source_location::current())
+      : location_(location), previous_(current_) {
+    current_ = this;
+  }
+  AllocationSite(const AllocationSite&) = delete;
+  AllocationSite& operator=(const AllocationSite&) = delete;
+  ~AllocationSite() { current_ = previous_; }
+
+  const std::source_location& location() const { return location_; }
+
+  // Innermost site active on the calling thread, or nullptr.
+  static const AllocationSite* current() { return current_; }
+};
+
+class AllocationStats {
+  private:
+  static constexpr size_t kBuckets = 64;
+
+  struct CallSite {
+    const char* function;
+    size_t count;
+    size_t bytes;
+  };
+
+  // File, line and column; compared by content so the same site seen from two translation units is one entry.
+  using SiteKey = std::tuple<std::string_view, uint_least32_t, uint_least32_t>;
+
+  std::atomic<size_t> allocations_ {0};
+  std::atomic<size_t> deallocations_ {0};
+  std::atomic<size_t> bytes_allocated_ {0};
+  std::atomic<size_t> bytes_deallocated_ {0};
+  std::atomic<size_t> live_bytes_ {0};
+  std::atomic<size_t> peak_bytes_ {0};
+  std::atomic<size_t> histogram_[kBuckets] {};
+  bool track_call_sites_ = false;
+  mutable std::mutex call_sites_mutex_;
+  std::map<SiteKey, CallSite> call_sites_;
+
+  static size_t bucket(size_t bytes) {
+    size_t index = 0;
+    while (index + 1 < kBuckets && (size_t(1) << index) < bytes) {
+      ++index;
+    }
+    return index;
+  }
+
+  std::vector<std::pair<SiteKey, CallSite>> sorted_call_sites() const {
+    std::lock_guard<std::mutex> lock(call_sites_mutex_);
+    std::vector<std::pair<SiteKey, CallSite>> sites(call_sites_.begin(), call_sites_.end());
+    std::sort(sites.begin(), sites.end(), [](const auto& lhs, const auto& rhs) {
+      return lhs.second.bytes > rhs.second.bytes;
+    });
+    return sites;
+  }
+
+  static void write_json_string(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        static const char digits[] = "0123456789abcdef";
+        out << "\\u00" << digits[(c >> 4) & 0xf] << digits[c & 0xf];
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+
+  public:
+  AllocationStats() = default;
+  explicit AllocationStats(bool track_call_sites) : track_call_sites_(track_call_sites) {}
+  AllocationStats(const AllocationStats&) = delete;
+  AllocationStats& operator=(const AllocationStats&) = delete;
+
+  // Allocations made outside any AllocationSite are grouped under an empty file name.
+  void on_allocate(size_t bytes, const AllocationSite* call_site = AllocationSite::current()) {
+    allocations_.fetch_add(1, std::memory_order_relaxed);
+    bytes_allocated_.fetch_add(bytes, std::memory_order_relaxed);
+    histogram_[bucket(bytes)].fetch_add(1, std::memory_order_relaxed);
+    size_t live = live_bytes_.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes_.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    if (track_call_sites_) {
+      SiteKey key("", 0, 0);
+      const char* function = "";
+      if (call_site != nullptr) {
+        const std::source_location& location = call_site->location();
+        key = SiteKey(location.file_name(), location.line(), location.column());
+        function = location.function_name();
+      }
+      std::lock_guard<std::mutex> lock(call_sites_mutex_);
+      CallSite& site = call_sites_.try_emplace(key, CallSite{function, 0, 0}).first->second;
+      ++site.count;
+      site.bytes += bytes;
+    }
+  }
+
+  void on_deallocate(size_t bytes) {
+    deallocations_.fetch_add(1, std::memory_order_relaxed);
+    bytes_deallocated_.fetch_add(bytes, std::memory_order_relaxed);
+    live_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+  }
+
+  size_t allocations() const { return allocations_.load(std::memory_order_relaxed); }
+
+  size_t deallocations() const { return deallocations_.load(std::memory_order_relaxed); }
+
+  size_t bytes_allocated() const { return bytes_allocated_.load(std::memory_order_relaxed); }
+
+  size_t bytes_deallocated() const { return bytes_deallocated_.load(std::memory_order_relaxed); }
+
+  size_t live_bytes() const { return live_bytes_.load(std::memory_order_relaxed); }
+
+  size_t peak_bytes() const { return peak_bytes_.load(std::memory_order_relaxed); }
+
+  size_t live_allocations() const { return allocations() - deallocations(); }
+
+  // Number of allocations of at most 2^index bytes and more than 2^(index - 1).
+  size_t histogram(size_t index) const { return histogram_[index].load(std::memory_order_relaxed); }
+
+  void reset() {
+    allocations_ = 0;
+    deallocations_ = 0;
+    bytes_allocated_ = 0;
+    bytes_deallocated_ = 0;
+    live_bytes_ = 0;
+    peak_bytes_ = 0;
+    for (auto& count : histogram_) {
+      count = 0;
+    }
+    std::lock_guard<std::mutex> lock(call_sites_mutex_);
+    call_sites_.clear();
+  }
+
+  void report(std::ostream& out) const {
+    out << "allocations: " << allocations() << " (" << bytes_allocated() << " bytes)\n"
+        << "deallocations: " << deallocations() << " (" << bytes_deallocated() << " bytes)\n"
+        << "live: " << live_allocations() << " (" << live_bytes() << " bytes)\n"
+        << "peak: " << peak_bytes() << " bytes\n";
+    for (size_t i = 0; i < kBuckets; ++i) {
+      if (histogram(i) != 0) {
+        out << "  <= " << (size_t(1) << i) << " bytes: " << histogram(i) << '\n';
+      }
+    }
+    for (const auto& [key, site] : sorted_call_sites()) {
+      const auto& [file, line, column] = key;
+      if (file.empty()) {
+        out << "  (unattributed)";
+      } else {
+        out << "  " << file << ':' << line << ':' << column << " in " << site.function;
+      }
+      out << ": " << site.count << " allocations, " << site.bytes << " bytes\n";
+    }
+  }
+
+  void dump_json(std::ostream& out) const {
+    out << "{\"allocations\":" << allocations()
+        << ",\"deallocations\":" << deallocations()
+        << ",\"bytes_allocated\":" << bytes_allocated()
+        << ",\"bytes_deallocated\":" << bytes_deallocated()
+        << ",\"live_bytes\":" << live_bytes()
+        << ",\"peak_bytes\":" << peak_bytes()
+        << ",\"histogram\":{";
+    bool first = true;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      if (histogram(i) != 0) {
+        out << (first ? "" : ",") << '"' << (size_t(1) << i) << "\":" << histogram(i);
+        first = false;
+      }
+    }
+    out << "},\"call_sites\":[";
+    first = true;
+    for (const auto& [key, site] : sorted_call_sites()) {
+      const auto& [file, line, column] = key;
+      out << (first ? "" : ",") << "{\"file\":";
+      write_json_string(out, file);
+      out << ",\"line\":" << line << ",\"column\":" << column << ",\"function\":";
+      write_json_string(out, site.function);
+      out << ",\"count\":" << site.count << ",\"bytes\":" << site.bytes << '}';
+      first = false;
+    }
+    out << "]}\n";
+  }
+};
+
+// Forwards to Allocator and records every request in an AllocationStats shared by all rebound copies,
+// attributed to the innermost AllocationSite on the allocating thread.
+// Building with ALLOCATION_TRACING=0 turns it into a plain pass-through.
+template <typename Allocator>
+class TracingAllocator {
+  private:
+  template <typename U> friend class TracingAllocator;
+  using Traits = std::allocator_traits<Allocator>;
+  Allocator inner;
+  AllocationStats* stats;
+
+  public:
+  using value_type = typename Traits::value_type;
+  using propagate_on_container_copy_assignment = typename Traits::propagate_on_container_copy_assignment;
+  using propagate_on_container_move_assignment = typename Traits::propagate_on_container_move_assignment;
+  using propagate_on_container_swap = typename Traits::propagate_on_container_swap;
+  using is_always_equal = std::false_type;
+
+  template <typename U> struct rebind {typedef TracingAllocator<typename Traits::template rebind_alloc<U>> other; };
+
+  TracingAllocator(AllocationStats& other_stats, const Allocator& allocator = Allocator())
+      : inner(allocator), stats(&other_stats) {}
+
+  template <typename U>
+  TracingAllocator(const TracingAllocator<U>& other) : inner(other.inner), stats(other.stats) {}
+
+  TracingAllocator select_on_container_copy_construction() const {
+    return TracingAllocator(*stats, Traits::select_on_container_copy_construction(inner));
+  }
+
+#if ALLOCATION_TRACING
+  value_type* allocate(size_t const n) {
+    value_type* ptr = Traits::allocate(inner, n);
+    stats->on_allocate(n * sizeof(value_type));
+    return ptr;
+  }
+
+  void deallocate(value_type* const ptr, size_t const n) {
+    stats->on_deallocate(n * sizeof(value_type));
+    Traits::deallocate(inner, ptr, n);
+  }
+#else
+  value_type* allocate(size_t const n) { return Traits::allocate(inner, n); }
+
+  void deallocate(value_type* const ptr, size_t const n) { Traits::deallocate(inner, ptr, n); }
+#endif
+
+  AllocationStats& statistics() const { return *stats; }
+
+  const Allocator& inner_allocator() const { return inner; }
+
+  template <typename U>
+  bool operator==(TracingAllocator<U> const& other_alloc) const {
+    return stats == other_alloc.stats && inner == other_alloc.inner;
+  }
+
+  template <typename U>
+  bool operator!=(TracingAllocator<U> const& other_alloc) const {
+    return !(*this == other_alloc);
+  }
+};
+
 template <typename T, typename Allocator = std::allocator<T>>
 class List {
   private:
@@ -75,8 +822,8 @@ class List {
   struct Node : BaseNode {
     T value;
     Node() {};
-    Node(BaseNode* pr, BaseNode* nxt, const T& value) : BaseNode(nxt, pr), value(value) {}
-    Node(BaseNode* pr, BaseNode* nxt) : BaseNode(nxt, pr) {}
+    template <typename... Args>
+    Node(BaseNode* pr, BaseNode* nxt, Args&&... args) : BaseNode(nxt, pr), value(std::forward<Args>(args)...) {}
   };
 
   BaseNode fake;
@@ -99,6 +846,97 @@ class List {
     }
   }
 
+  void steal(List& list) {
+    if (list.size_ == 0) {
+      initialize_fake();
+      size_ = 0;
+      return;
+    }
+    fake.next = list.fake.next;
+    fake.prev = list.fake.prev;
+    fake.next->prev = &fake;
+    fake.prev->next = &fake;
+    size_ = list.size_;
+    list.initialize_fake();
+    list.size_ = 0;
+  }
+
+  void relink_fake(List& list) {
+    if (fake.next == &list.fake) {
+      initialize_fake();
+    } else {
+      fake.next->prev = &fake;
+      fake.prev->next = &fake;
+    }
+  }
+
+  static void transfer(BaseNode* pos, BaseNode* first, BaseNode* last) {
+    if (first == last || pos == last || pos == first) {
+      return;
+    }
+    BaseNode* tail = last->prev;
+    first->prev->next = last;
+    last->prev = first->prev;
+    first->prev = pos->prev;
+    tail->next = pos;
+    pos->prev->next = first;
+    pos->prev = tail;
+  }
+
+  void relink(BaseNode* head) {
+    BaseNode* prev = &fake;
+    while (head != nullptr) {
+      prev->next = head;
+      head->prev = prev;
+      prev = head;
+      head = head->next;
+    }
+    prev->next = &fake;
+    fake.prev = prev;
+  }
+
+  static BaseNode* append_run(BaseNode* run, BaseNode* tail) {
+    if (run == nullptr) {
+      return tail;
+    }
+    BaseNode* last = run;
+    while (last->next != nullptr) {
+      last = last->next;
+    }
+    last->next = tail;
+    return run;
+  }
+
+  // Merges the null-terminated run from into into, leaving from empty. If comp
+  // throws, into still holds every node of both runs, in unspecified order.
+  template <typename Compare>
+  static void merge_runs(BaseNode*& into, BaseNode*& from, Compare& comp) {
+    BaseNode head;
+    BaseNode* last = &head;
+    BaseNode* first = into;
+    BaseNode* second = from;
+    try {
+      while (first != nullptr && second != nullptr) {
+        if (comp(static_cast<Node*>(second)->value, static_cast<Node*>(first)->value)) {
+          last->next = second;
+          second = second->next;
+        } else {
+          last->next = first;
+          first = first->next;
+        }
+        last = last->next;
+      }
+    } catch(...) {
+      last->next = first;
+      into = append_run(head.next, second);
+      from = nullptr;
+      throw;
+    }
+    last->next = (first != nullptr ? first : second);
+    into = head.next;
+    from = nullptr;
+  }
+
   public:
 
   ~List() {
@@ -178,18 +1016,54 @@ class List {
     }
   }
 
+  List(List&& list) noexcept : allocator(std::move(list.allocator)) {
+    steal(list);
+  }
+
+  List& operator=(List&& list) noexcept(AllocTraits::propagate_on_container_move_assignment::value ||
+                                        AllocTraits::is_always_equal::value) {
+    if (this == &list) {
+      return *this;
+    }
+    clear();
+    if (AllocTraits::propagate_on_container_move_assignment::value) {
+      allocator = std::move(list.allocator);
+      node_allocator = NodeAlloc(allocator);
+      steal(list);
+    } else if (allocator == list.allocator) {
+      steal(list);
+    } else {
+      for (T& value : list) {
+        emplace_back(std::move(value));
+      }
+      list.clear();
+    }
+    return *this;
+  }
+
   List& operator=(const List& list) {
+    if (this == &list) {
+      return *this;
+    }
     if (AllocTraits::propagate_on_container_copy_assignment::value) {
+      if (allocator != list.allocator) {
+        clear();
+      }
       allocator = list.allocator;
+      node_allocator = NodeAlloc(allocator);
     }
-    List copy(allocator);
-    const_iterator it = list.cbegin();
-    for (size_t i = 0; i < list.size(); ++i) {
-      copy.push_back(*it);
-      ++it;
+    iterator dst = begin();
+    const_iterator src = list.cbegin();
+    size_t common = std::min(size_, list.size_);
+    for (size_t i = 0; i < common; ++i, ++dst, ++src) {
+      *dst = *src;
+    }
+    while (size_ > list.size_) {
+      pop_back();
+    }
+    for (; src != list.cend(); ++src) {
+      emplace_back(*src);
     }
-    std::swap(size_, copy.size_);
-    std::swap(fake, copy.fake);
     return *this;
   }
 
@@ -218,10 +1092,7 @@ class List {
     Iterator(node_type base_node) : ptr(base_node) {}
     Iterator(const Iterator<false>& iterator) : ptr(iterator.get_ptr()) {}
 
-    Iterator& operator=(const Iterator& iterator) {
-      ptr = iterator.get_ptr();
-      return *this;
-    }
+    Iterator& operator=(const Iterator&) = default;
 
     reference operator*() { return static_cast<Node_type>(ptr)->value; }
 
@@ -269,16 +1140,26 @@ class List {
   const_reverse_iterator crbegin() const { return const_reverse_iterator(&fake); }
   const_reverse_iterator crend() const { return const_reverse_iterator(fake.next); }
 
-  void insert(const_iterator it, const T& val) {
+  template <typename... Args>
+  iterator emplace(const_iterator it, Args&&... args) {
     BaseNode* cur_vertex = const_cast<BaseNode*>(it.get_ptr());
     BaseNode* prev_vertex = cur_vertex->prev;
     Node* new_vertex = NodeAllocTraits::allocate(node_allocator, 1);
-    NodeAllocTraits::construct(node_allocator, new_vertex, prev_vertex, cur_vertex, val);
+    try {
+      NodeAllocTraits::construct(node_allocator, new_vertex, prev_vertex, cur_vertex, std::forward<Args>(args)...);
+    } catch(...) {
+      NodeAllocTraits::deallocate(node_allocator, new_vertex, 1);
+      throw;
+    }
     prev_vertex->next = new_vertex;
     cur_vertex->prev = new_vertex;
     ++size_;
+    return iterator(new_vertex);
   }
 
+  void insert(const_iterator it, const T& val) { emplace(it, val); }
+  void insert(const_iterator it, T&& val) { emplace(it, std::move(val)); }
+
   void erase(const_iterator it) {
     auto ans = it.get_ptr()->next;
     auto prev = it.get_ptr()->prev;
@@ -289,7 +1170,492 @@ class List {
     NodeAllocTraits::deallocate(node_allocator, static_cast<Node*>(const_cast<BaseNode*>(it.get_ptr())), 1);
   }
   void push_front(const T& value) { insert(begin(), value); }
+  void push_front(T&& value) { insert(begin(), std::move(value)); }
   void push_back(const T& value) { insert(end(), value); }
+  void push_back(T&& value) { insert(end(), std::move(value)); }
   void pop_front() { erase(begin()); }
   void pop_back() { erase(--end()); }
+
+  template <typename... Args>
+  T& emplace_front(Args&&... args) { return *emplace(begin(), std::forward<Args>(args)...); }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) { return *emplace(end(), std::forward<Args>(args)...); }
+
+  void clear() {
+    while (size_ != 0) {
+      pop_back();
+    }
+  }
+
+  void swap(List& list) {
+    std::swap(fake.next, list.fake.next);
+    std::swap(fake.prev, list.fake.prev);
+    std::swap(size_, list.size_);
+    relink_fake(list);
+    list.relink_fake(*this);
+    if (AllocTraits::propagate_on_container_swap::value) {
+      std::swap(allocator, list.allocator);
+      std::swap(node_allocator, list.node_allocator);
+    }
+  }
+
+  void splice(const_iterator pos, List& list) {
+    transfer(const_cast<BaseNode*>(pos.get_ptr()), list.fake.next, &list.fake);
+    size_ += list.size_;
+    list.size_ = 0;
+  }
+
+  void splice(const_iterator pos, List& list, const_iterator it) {
+    BaseNode* node = const_cast<BaseNode*>(it.get_ptr());
+    transfer(const_cast<BaseNode*>(pos.get_ptr()), node, node->next);
+    --list.size_;
+    ++size_;
+  }
+
+  void splice(const_iterator pos, List& list, const_iterator first, const_iterator last) {
+    if (&list != this) {
+      size_t count = 0;
+      for (const_iterator it = first; it != last; ++it) {
+        ++count;
+      }
+      list.size_ -= count;
+      size_ += count;
+    }
+    transfer(const_cast<BaseNode*>(pos.get_ptr()), const_cast<BaseNode*>(first.get_ptr()),
+             const_cast<BaseNode*>(last.get_ptr()));
+  }
+
+  void splice(const_iterator pos, List&& list) { splice(pos, list); }
+  void splice(const_iterator pos, List&& list, const_iterator it) { splice(pos, list, it); }
+
+  template <typename Compare>
+  void merge(List& list, Compare comp) {
+    if (&list == this || list.size_ == 0) {
+      return;
+    }
+    fake.prev->next = nullptr;
+    list.fake.prev->next = nullptr;
+    BaseNode* head = (size_ == 0 ? nullptr : fake.next);
+    BaseNode* other = list.fake.next;
+    size_ += list.size_;
+    list.initialize_fake();
+    list.size_ = 0;
+    try {
+      merge_runs(head, other, comp);
+    } catch(...) {
+      relink(head);
+      throw;
+    }
+    relink(head);
+  }
+
+  void merge(List& list) { merge(list, std::less<T>()); }
+  void merge(List&& list) { merge(list); }
+
+  template <typename Compare>
+  void sort(Compare comp) {
+    if (size_ < 2) {
+      return;
+    }
+    BaseNode* bins[64] = {};
+    BaseNode* head = fake.next;
+    BaseNode* node = nullptr;
+    BaseNode* result = nullptr;
+    fake.prev->next = nullptr;
+    try {
+      while (head != nullptr) {
+        node = head;
+        head = head->next;
+        node->next = nullptr;
+        size_t i = 0;
+        for (; bins[i] != nullptr; ++i) {
+          merge_runs(bins[i], node, comp);
+          node = bins[i];
+          bins[i] = nullptr;
+        }
+        bins[i] = node;
+        node = nullptr;
+      }
+      for (BaseNode*& bin : bins) {
+        if (bin != nullptr) {
+          merge_runs(bin, result, comp);
+          result = bin;
+          bin = nullptr;
+        }
+      }
+    } catch(...) {
+      // Put every run back so the list keeps all of its nodes, in unspecified order.
+      for (BaseNode* bin : bins) {
+        result = append_run(bin, result);
+      }
+      relink(append_run(append_run(result, node), head));
+      throw;
+    }
+    relink(result);
+  }
+
+  void sort() { sort(std::less<T>()); }
 };
+
+// Stores up to NodeCapacity elements per node. insert invalidates iterators
+// and references into the node it inserts into (elements after the insertion
+// point shift, and a full node is split in half). erase invalidates those
+// into the node it erases from and, once that node drops below half full,
+// into the neighbour it is merged or balanced with: its successor, or its
+// predecessor when it is the last node. Iterators into other nodes stay valid.
+template <typename T, typename Allocator = std::allocator<T>, size_t NodeCapacity = 16>
+class UnrolledList {
+  private:
+  static_assert(NodeCapacity >= 2);
+
+  size_t size_ = 0;
+  struct BaseNode {
+    BaseNode* next;
+    BaseNode* prev;
+    size_t count = 0;
+    BaseNode() : next(nullptr), prev(nullptr) {}
+    BaseNode(BaseNode* nxt, BaseNode* pr) : next(nxt), prev(pr) {}
+  };
+
+  struct Node : BaseNode {
+    alignas(T) unsigned char storage[NodeCapacity * sizeof(T)];
+    Node(BaseNode* pr, BaseNode* nxt) : BaseNode(nxt, pr) {}
+    T* values() { return reinterpret_cast<T*>(storage); }
+    const T* values() const { return reinterpret_cast<const T*>(storage); }
+  };
+
+  BaseNode fake;
+  [[ no_unique_address ]] Allocator allocator;
+  using AllocTraits = std::allocator_traits<Allocator>;
+  using NodeAlloc = typename AllocTraits::template rebind_alloc<Node>;
+  NodeAlloc node_allocator = allocator;
+  using NodeAllocTraits = typename AllocTraits::template rebind_traits<Node>;
+
+  void initialize_fake() {
+    fake.prev = &fake;
+    fake.next = &fake;
+  }
+
+  Node* create_node(BaseNode* prev, BaseNode* next) {
+    Node* node = NodeAllocTraits::allocate(node_allocator, 1);
+    NodeAllocTraits::construct(node_allocator, node, prev, next);
+    prev->next = node;
+    next->prev = node;
+    return node;
+  }
+
+  void destroy_node(Node* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    NodeAllocTraits::destroy(node_allocator, node);
+    NodeAllocTraits::deallocate(node_allocator, node, 1);
+  }
+
+  void clear_list() {
+    while (fake.next != &fake) {
+      Node* node = static_cast<Node*>(fake.next);
+      for (size_t i = 0; i < node->count; ++i) {
+        AllocTraits::destroy(allocator, node->values() + i);
+      }
+      destroy_node(node);
+    }
+    size_ = 0;
+  }
+
+  void move_values(Node* from, size_t first, size_t last, Node* to) {
+    for (size_t i = first; i < last; ++i) {
+      AllocTraits::construct(allocator, to->values() + to->count, std::move(from->values()[i]));
+      ++to->count;
+      AllocTraits::destroy(allocator, from->values() + i);
+    }
+    from->count -= last - first;
+  }
+
+  template <typename... Args>
+  void insert_value(BaseNode* base, size_t index, Args&&... args);
+
+  void rebalance(Node* left, Node* right);
+
+  public:
+  template <bool is_const>
+  class Iterator {
+    private:
+    using node_type = std::conditional_t<is_const, const BaseNode*, BaseNode*>;
+    using Node_type = std::conditional_t<is_const, const Node*, Node*>;
+    node_type ptr;
+    size_t index = 0;
+
+    public:
+
+    node_type get_ptr() const { return ptr; }
+    size_t get_index() const { return index; }
+    using value_type = T;
+    using reference = std::conditional_t<is_const, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = ptrdiff_t;
+
+    Iterator() = default;
+    ~Iterator() = default;
+
+    Iterator(node_type base_node, size_t idx = 0) : ptr(base_node), index(idx) {}
+    Iterator(const Iterator<false>& iterator) : ptr(iterator.get_ptr()), index(iterator.get_index()) {}
+
+    Iterator& operator=(const Iterator&) = default;
+
+    reference operator*() const { return static_cast<Node_type>(ptr)->values()[index]; }
+
+    Iterator& operator++() {
+      if (++index == ptr->count) {
+        ptr = ptr->next;
+        index = 0;
+      }
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+    Iterator& operator--() {
+      if (index == 0) {
+        ptr = ptr->prev;
+        index = ptr->count;
+      }
+      --index;
+      return *this;
+    }
+    Iterator operator--(int) {
+      Iterator copy = *this;
+      --*this;
+      return copy;
+    }
+
+    bool operator==(const Iterator& it) const { return ptr == it.get_ptr() && index == it.get_index(); }
+    bool operator!=(const Iterator& it) const { return !(*this == it); }
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  ~UnrolledList() { clear_list(); }
+
+  UnrolledList() : UnrolledList(Allocator()) {}
+
+  UnrolledList(Allocator allocator2) : allocator(allocator2) {
+    initialize_fake();
+  }
+
+  UnrolledList(size_t amount) : UnrolledList(amount, Allocator()) {}
+
+  UnrolledList(size_t amount, Allocator allocator2) : allocator(allocator2) {
+    initialize_fake();
+    try {
+      for (size_t i = 0; i < amount; ++i) {
+        insert_value(&fake, 0);
+      }
+    } catch(...) {
+      clear_list();
+      throw;
+    }
+  }
+
+  UnrolledList(size_t amount, const T& value) : UnrolledList(amount, value, Allocator()) {}
+
+  UnrolledList(size_t amount, const T& value, Allocator allocator2) : allocator(allocator2) {
+    initialize_fake();
+    try {
+      for (size_t i = 0; i < amount; ++i) {
+        insert_value(&fake, 0, value);
+      }
+    } catch(...) {
+      clear_list();
+      throw;
+    }
+  }
+
+  UnrolledList(const UnrolledList& list)
+    : allocator(AllocTraits::select_on_container_copy_construction(list.allocator)) {
+    initialize_fake();
+    try {
+      for (const T& value : list) {
+        insert_value(&fake, 0, value);
+      }
+    } catch(...) {
+      clear_list();
+      throw;
+    }
+  }
+
+  UnrolledList& operator=(const UnrolledList& list) {
+    if (this == &list) {
+      return *this;
+    }
+    UnrolledList copy(AllocTraits::propagate_on_container_copy_assignment::value ? list.allocator : allocator);
+    for (const T& value : list) {
+      copy.push_back(value);
+    }
+    if (AllocTraits::propagate_on_container_copy_assignment::value) {
+      clear_list();
+      allocator = copy.allocator;
+      node_allocator = copy.node_allocator;
+    }
+    swap(copy);
+    return *this;
+  }
+
+  void swap(UnrolledList& list) {
+    std::swap(fake.next, list.fake.next);
+    std::swap(fake.prev, list.fake.prev);
+    if (fake.next == &list.fake) {
+      initialize_fake();
+    } else {
+      fake.next->prev = &fake;
+      fake.prev->next = &fake;
+    }
+    if (list.fake.next == &fake) {
+      list.initialize_fake();
+    } else {
+      list.fake.next->prev = &list.fake;
+      list.fake.prev->next = &list.fake;
+    }
+    std::swap(size_, list.size_);
+    if (AllocTraits::propagate_on_container_swap::value) {
+      std::swap(allocator, list.allocator);
+      std::swap(node_allocator, list.node_allocator);
+    }
+  }
+
+  Allocator get_allocator() { return allocator; }
+
+  size_t size() const { return size_; }
+
+  iterator begin() { return iterator(fake.next); }
+  const_iterator begin() const { return const_iterator(fake.next); }
+  const_iterator cbegin() const { return const_iterator(fake.next); }
+
+  iterator end() { return iterator(&fake); }
+  const_iterator end() const { return const_iterator(&fake); }
+  const_iterator cend() const { return const_iterator(&fake); }
+
+  reverse_iterator rbegin() { return reverse_iterator(end()); }
+  const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+  reverse_iterator rend() { return reverse_iterator(begin()); }
+  const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+  const_reverse_iterator crbegin() const { return const_reverse_iterator(end()); }
+  const_reverse_iterator crend() const { return const_reverse_iterator(begin()); }
+
+  void insert(const_iterator it, const T& val) {
+    insert_value(const_cast<BaseNode*>(it.get_ptr()), it.get_index(), val);
+  }
+
+  void erase(const_iterator it);
+
+  void push_front(const T& value) { insert(begin(), value); }
+  void push_back(const T& value) { insert(end(), value); }
+  void pop_front() { erase(begin()); }
+  void pop_back() { erase(--end()); }
+};
+
+template <typename T, typename Allocator, size_t NodeCapacity>
+template <typename... Args>
+void UnrolledList<T, Allocator, NodeCapacity>::insert_value(BaseNode* base, size_t index, Args&&... args) {
+  if (base == &fake || (index == 0 && base->prev != &fake && base->prev->count < NodeCapacity)) {
+    base = base->prev;
+    if (base == &fake || base->count == NodeCapacity) {
+      base = create_node(base, base->next);
+    }
+    AllocTraits::construct(allocator, static_cast<Node*>(base)->values() + base->count, std::forward<Args>(args)...);
+    ++base->count;
+    ++size_;
+    return;
+  }
+  T value(std::forward<Args>(args)...);
+  if (base->count == NodeCapacity) {
+    Node* left = static_cast<Node*>(base);
+    Node* right = create_node(base, base->next);
+    try {
+      move_values(left, NodeCapacity / 2, NodeCapacity, right);
+    } catch(...) {
+      if (right->count == 0) {
+        destroy_node(right);
+      }
+      throw;
+    }
+    if (index > left->count) {
+      index -= left->count;
+      base = right;
+    }
+  }
+  Node* node = static_cast<Node*>(base);
+  T* values = node->values();
+  if (index == node->count) {
+    AllocTraits::construct(allocator, values + index, std::move(value));
+  } else {
+    AllocTraits::construct(allocator, values + node->count, std::move(values[node->count - 1]));
+    std::move_backward(values + index, values + node->count - 1, values + node->count);
+    values[index] = std::move(value);
+  }
+  ++node->count;
+  ++size_;
+}
+
+template <typename T, typename Allocator, size_t NodeCapacity>
+void UnrolledList<T, Allocator, NodeCapacity>::erase(const_iterator it) {
+  Node* node = static_cast<Node*>(const_cast<BaseNode*>(it.get_ptr()));
+  T* values = node->values();
+  std::move(values + it.get_index() + 1, values + node->count, values + it.get_index());
+  AllocTraits::destroy(allocator, values + node->count - 1);
+  --node->count;
+  --size_;
+  if (node->count == 0) {
+    destroy_node(node);
+    return;
+  }
+  if (node->count >= NodeCapacity / 2) {
+    return;
+  }
+  if (node->next != &fake) {
+    rebalance(node, static_cast<Node*>(node->next));
+  } else if (node->prev != &fake) {
+    rebalance(static_cast<Node*>(node->prev), node);
+  }
+}
+
+// Merges two neighbouring nodes when their values fit in one, otherwise
+// moves values across so that both end up at least half full.
+template <typename T, typename Allocator, size_t NodeCapacity>
+void UnrolledList<T, Allocator, NodeCapacity>::rebalance(Node* left, Node* right) {
+  size_t total = left->count + right->count;
+  if (total <= NodeCapacity) {
+    move_values(right, 0, right->count, left);
+    destroy_node(right);
+    return;
+  }
+  T* left_values = left->values();
+  T* right_values = right->values();
+  size_t half = total / 2;
+  if (left->count < half) {
+    size_t take = half - left->count;
+    move_values(right, 0, take, left);
+    for (size_t i = 0; i < right->count; ++i) {
+      AllocTraits::construct(allocator, right_values + i, std::move(right_values[i + take]));
+      AllocTraits::destroy(allocator, right_values + i + take);
+    }
+    return;
+  }
+  size_t take = left->count - half;
+  for (size_t i = right->count; i-- > 0;) {
+    AllocTraits::construct(allocator, right_values + i + take, std::move(right_values[i]));
+    AllocTraits::destroy(allocator, right_values + i);
+  }
+  for (size_t i = 0; i < take; ++i) {
+    AllocTraits::construct(allocator, right_values + i, std::move(left_values[half + i]));
+    AllocTraits::destroy(allocator, left_values + half + i);
+  }
+  left->count = half;
+  right->count += take;
+}
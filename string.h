@@ -1,6 +1,257 @@
 #include <algorithm>
 #include <iostream>
+#include <fstream>
 #include <cstring>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <atomic>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+uint64_t wyMix(uint64_t first, uint64_t second) {
+  __uint128_t product = static_cast<__uint128_t>(first) * second;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+uint64_t wyRead8(const unsigned char* bytes) {
+  uint64_t value;
+  memcpy(&value, bytes, 8);
+  return value;
+}
+
+uint64_t wyRead4(const unsigned char* bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, 4);
+  return value;
+}
+
+size_t hashBytes(const char* data, size_t len) {
+  static const uint64_t secret[4] = {0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull,
+                                     0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull};
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  uint64_t seed = wyMix(secret[0], secret[1]);
+  uint64_t first = 0;
+  uint64_t second = 0;
+  if (len <= 16) {
+    if (len >= 4) {
+      size_t shift = (len >> 3) << 2;
+      first = (wyRead4(bytes) << 32) | wyRead4(bytes + shift);
+      second = (wyRead4(bytes + len - 4) << 32) | wyRead4(bytes + len - 4 - shift);
+    } else if (len > 0) {
+      first = (static_cast<uint64_t>(bytes[0]) << 16) |
+              (static_cast<uint64_t>(bytes[len >> 1]) << 8) | bytes[len - 1];
+    }
+  } else {
+    size_t rest = len;
+    if (rest > 48) {
+      uint64_t seed_1 = seed;
+      uint64_t seed_2 = seed;
+      do {
+        seed = wyMix(wyRead8(bytes) ^ secret[1], wyRead8(bytes + 8) ^ seed);
+        seed_1 = wyMix(wyRead8(bytes + 16) ^ secret[2], wyRead8(bytes + 24) ^ seed_1);
+        seed_2 = wyMix(wyRead8(bytes + 32) ^ secret[3], wyRead8(bytes + 40) ^ seed_2);
+        bytes += 48;
+        rest -= 48;
+      } while (rest > 48);
+      seed ^= seed_1 ^ seed_2;
+    }
+    while (rest > 16) {
+      seed = wyMix(wyRead8(bytes) ^ secret[1], wyRead8(bytes + 8) ^ seed);
+      bytes += 16;
+      rest -= 16;
+    }
+    first = wyRead8(bytes + rest - 16);
+    second = wyRead8(bytes + rest - 8);
+  }
+  __uint128_t product = static_cast<__uint128_t>(first ^ secret[1]) * (second ^ seed);
+  first = static_cast<uint64_t>(product);
+  second = static_cast<uint64_t>(product >> 64);
+  return wyMix(first ^ secret[0] ^ len, second ^ secret[1]);
+}
+
+class SplitRange;
+
+class StringView {
+  private:
+  const char* data_ = nullptr;
+  int size_ = 0;
+
+  public:
+  StringView() = default;
+
+  StringView(const char* chr) : data_(chr), size_(strlen(chr)) {}
+
+  StringView(const char* chr, int count) : data_(chr), size_(count) {}
+
+  int length() const { return size_; }
+
+  int size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  const char& operator[](int index) const { return data_[index]; }
+
+  const char& front() const { return data_[0]; }
+
+  const char& back() const { return data_[size_ - 1]; }
+
+  const char* data() const { return data_; }
+
+  void remove_prefix(int count) {
+    data_ += count;
+    size_ -= count;
+  }
+
+  void remove_suffix(int count) { size_ -= count; }
+
+  StringView substr(int index, int count_index) const { return StringView(data_ + index, count_index); }
+
+  size_t find(StringView substr_) const;
+
+  int rfind(StringView substr_) const;
+
+  int compare(StringView str) const;
+
+  SplitRange split(StringView delims) const;
+
+  size_t hash() const { return hashBytes(data_, size_); }
+};
+
+size_t StringView::find(StringView substr_) const {
+  if (substr_.size_ == 0) {
+    return 0;
+  }
+  const char* begin = data_;
+  const char* last = data_ + size_ - substr_.size_;
+  while (begin <= last) {
+    begin = static_cast<const char*>(memchr(begin, substr_[0], last - begin + 1));
+    if (begin == nullptr) {
+      break;
+    }
+    if (memcmp(begin + 1, substr_.data_ + 1, substr_.size_ - 1) == 0) {
+      return begin - data_;
+    }
+    ++begin;
+  }
+  return size_;
+}
+
+int StringView::rfind(StringView substr_) const {
+  for (int i = size_ - substr_.size_; i >= 0; --i) {
+    if (memcmp(data_ + i, substr_.data_, substr_.size_) == 0) {
+      return i;
+    }
+  }
+  return size_;
+}
+
+int StringView::compare(StringView str) const {
+  if (size_ != str.size_) {
+    return size_ < str.size_ ? -1 : 1;
+  }
+  return memcmp(data_, str.data_, size_);
+}
+
+// Copies the delimiters, so a set built from a temporary stays valid.
+// The table covers every delimiter; the first four also feed memchr/SSE2.
+class DelimiterSet {
+  private:
+  char delims_[4] = {};
+  int count_ = 0;
+  bool table_[256] = {};
+
+  public:
+  DelimiterSet(StringView delims) : count_(delims.size()) {
+    for (int i = 0; i < delims.size(); ++i) {
+      if (i < 4) {
+        delims_[i] = delims[i];
+      }
+      table_[static_cast<unsigned char>(delims[i])] = true;
+    }
+  }
+
+  int find(StringView str, int from) const;
+};
+
+int DelimiterSet::find(StringView str, int from) const {
+  if (count_ == 1) {
+    const void* found = memchr(str.data() + from, delims_[0], str.size() - from);
+    return found == nullptr ? str.size() : static_cast<const char*>(found) - str.data();
+  }
+#ifdef __SSE2__
+  if (count_ > 1 && count_ <= 4) {
+    __m128i masks[4];
+    for (int i = 0; i < 4; ++i) {
+      masks[i] = _mm_set1_epi8(delims_[std::min(i, count_ - 1)]);
+    }
+    for (; from + 16 <= str.size(); from += 16) {
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + from));
+      __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, masks[0]), _mm_cmpeq_epi8(block, masks[1])),
+                                  _mm_or_si128(_mm_cmpeq_epi8(block, masks[2]), _mm_cmpeq_epi8(block, masks[3])));
+      int bits = _mm_movemask_epi8(hits);
+      if (bits != 0) {
+        return from + __builtin_ctz(bits);
+      }
+    }
+  }
+#endif
+  while (from < str.size() && !table_[static_cast<unsigned char>(str[from])]) {
+    ++from;
+  }
+  return from;
+}
+
+class SplitRange {
+  private:
+  StringView str_;
+  DelimiterSet delims_;
+
+  public:
+  class Iterator {
+    private:
+    const SplitRange* range_ = nullptr;
+    int begin_ = 0;
+    int end_ = 0;
+
+    public:
+    using value_type = StringView;
+    using reference = StringView;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = ptrdiff_t;
+
+    Iterator() = default;
+    Iterator(const SplitRange* range, int begin)
+      : range_(range), begin_(begin),
+        end_(begin > range->str_.size() ? begin : range->delims_.find(range->str_, begin)) {}
+
+    StringView operator*() const { return range_->str_.substr(begin_, end_ - begin_); }
+
+    Iterator& operator++() {
+      *this = Iterator(range_, end_ + 1);
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const Iterator& it) const { return begin_ == it.begin_; }
+    bool operator!=(const Iterator& it) const { return begin_ != it.begin_; }
+  };
+
+  SplitRange(StringView str, StringView delims) : str_(str), delims_(delims) {}
+
+  Iterator begin() const { return Iterator(this, 0); }
+  Iterator end() const { return Iterator(this, str_.size() + 1); }
+};
+
+SplitRange StringView::split(StringView delims) const {
+  return SplitRange(*this, delims);
+}
 
 class String {
   private:
@@ -8,8 +259,35 @@ class String {
   int capacity_ = 0;
   char* data_ = nullptr;
 
-  void changeCap();
-  void swap(String &str);
+  // Shared terminator for empty strings that own no buffer, so default
+  // construction and moves never allocate. It is never written to.
+  static inline char empty_[1] = {};
+
+  static void freeData(char* data) {
+    if (data != empty_) {
+      delete[] data;
+    }
+  }
+
+  struct Reserve {};
+
+  // Empty string with room for capacity chars, in a single allocation.
+  String(Reserve, int capacity) : size_(0), capacity_(capacity), data_(new char[capacity + 1]) {
+    data_[0] = '\0';
+  }
+
+  void changeCap(int new_size);
+  void swap(String &str) noexcept;
+
+  friend String operator+(const char chr, StringView str_1);
+  friend String operator+(StringView str_1, StringView str_2);
+  friend String operator+(StringView str_1, const char chr);
+
+  template <typename... Args>
+  friend String concat(const Args&... args);
+
+  template <typename Range>
+  friend String join(const Range& range, StringView sep);
 
   public:
   String(const char* chr) : size_(strlen(chr)), capacity_(size_), data_(new char[capacity_ + 1]) {
@@ -22,20 +300,30 @@ class String {
     data_[size_] = '\0';
   }
 
-  String() : size_(0), capacity_(0), data_(new char[1]) {
-    data_[0] = '\0';
-  };
+  explicit String(StringView str) : String(str.size(), '\0') {
+    std::copy(str.data(), str.data() + size_, data_);
+  }
+
+  String() noexcept : size_(0), capacity_(0), data_(empty_) {}
 
   String(const String& str) : String(str.size_, '\0') {
     std::copy(str.data_, str.data_ + size_ + 1, data_);
   }
 
-  String& operator=(String str);
-  String& operator+=(const String& str);
+  String(String&& str) noexcept : String() {
+    swap(str);
+  }
+
+  String& operator=(String str) noexcept;
+  String& operator+=(StringView str);
   String& operator+=(const char& chr);
 
   String substr(int index, int count_index) const;
 
+  StringView substr_view(int index, int count_index) const { return StringView(data_ + index, count_index); }
+
+  operator StringView() const { return StringView(data_, size_); }
+
   int length() const { return size_; }
 
   int capacity() const { return capacity_; }
@@ -61,8 +349,10 @@ class String {
   bool empty() { return size_ == 0; }
 
   void clear() {
-    size_ = 0;
-    data_[size_] = '\0';
+    if (size_ != 0) {
+      size_ = 0;
+      data_[size_] = '\0';
+    }
   }
 
   void push_back(const char& chr) { *this += chr; }
@@ -72,148 +362,165 @@ class String {
     --size_;
   }
 
+  void reserve(int new_capacity);
+
   void shrink_to_fit();
 
-  size_t find(const String& substr_) const;
+  size_t find(StringView substr_) const { return StringView(*this).find(substr_); }
+
+  int rfind(StringView substr_) const { return StringView(*this).rfind(substr_); }
+
+  int compare(StringView str) const { return StringView(*this).compare(str); }
 
-  int rfind(const String& substr_) const;
+  SplitRange split(StringView delims) const { return StringView(*this).split(delims); }
 
-  ~String() { delete[] data_; }
+  size_t hash() const { return hashBytes(data_, size_); }
+
+  ~String() { freeData(data_); }
 };
 
-void String::swap(String &str) {
+void String::swap(String &str) noexcept {
   std::swap(str.data_, data_);
   std::swap(str.size_, size_);
   std::swap(str.capacity_, capacity_);
 }
 
-void String::changeCap() {
-  if (size_ != 0) {
-    capacity_ = 2 * size_;
-  } else {
-    capacity_ = 1;
+void String::reserve(int new_capacity) {
+  if (new_capacity <= capacity_) {
+    return;
   }
-  char* tmp_data_ = new char[capacity_ + 1];
-  strcpy(tmp_data_, data_);
-  delete[] data_;
+  char* tmp_data_ = new char[new_capacity + 1];
+  std::copy(data_, data_ + size_, tmp_data_);
+  tmp_data_[size_] = '\0';
+  freeData(data_);
   data_ = tmp_data_;
+  capacity_ = new_capacity;
+}
+
+void String::changeCap(int new_size) {
+  if (new_size > INT_MAX / 2 - 1) {
+    reserve(INT_MAX - 1);
+  } else if (new_size != 0) {
+    reserve(2 * new_size);
+  } else {
+    reserve(1);
+  }
 }
 
-bool operator>(const String& str_1, const String& str_2);
-bool operator<=(const String& str_1, const String& str_2);
-bool operator>=(const String& str_1, const String& str_2);
-bool operator==(const String& str_1, const String& str_2);
-bool operator!=(const String& str_1, const String& str_2);
-String operator+(const char chr, const String &str_1);
-String operator+(String str_1, const char chr);
-String operator+(String str_1, const String &str_2);
+bool operator>(StringView str_1, StringView str_2);
+bool operator<=(StringView str_1, StringView str_2);
+bool operator>=(StringView str_1, StringView str_2);
+bool operator==(StringView str_1, StringView str_2);
+bool operator!=(StringView str_1, StringView str_2);
+String operator+(const char chr, StringView str_1);
+String operator+(String&& str_1, const char chr);
+String operator+(StringView str_1, const char chr);
+String operator+(String&& str_1, StringView str_2);
+String operator+(StringView str_1, StringView str_2);
+String operator+(const char* str_1, StringView str_2);
 
-String& String::operator+=(const String& str) {
-  size_t prev_size_ = size_;
-  size_ += str.size_;
-  if (size_ >= capacity_) {
-    changeCap();
+String& String::operator+=(StringView str) {
+  if (str.empty()) {
+    return *this;
   }
-  std::copy(str.data_, str.data_ + str.size_, data_ + prev_size_);
+  if (str.data() >= data_ && str.data() <= data_ + size_) {
+    return *this += String(str);
+  }
+  int new_size_ = size_ + str.size();
+  if (new_size_ > capacity_) {
+    changeCap(new_size_);
+  }
+  std::copy(str.data(), str.data() + str.size(), data_ + size_);
+  size_ = new_size_;
   data_[size_] = '\0';
   return *this;
 }
 
 String& String::operator+=(const char& chr) {
-  if (size_ + 1 >= capacity_) {
-    changeCap();
+  if (size_ + 1 > capacity_) {
+    changeCap(size_ + 1);
   }
   data_[size_++] = chr;
   data_[size_] = '\0';
   return *this;
 }
 
-String& String::operator=(String str) {
+String& String::operator=(String str) noexcept {
   swap(str);
   return *this;
 }
 
-bool operator<(const String& str_1, const String& str_2) {
-  if (str_1.length() < str_2.length()) {
-    return true;
-  } else if (str_1.length() > str_2.length()) {
-    return false;
-  } else {
-    for (int i = 0; i < str_1.length(); ++ i) {
-      if (str_1[i] < str_2[i]) {
-        return true;
-      }
-      if (str_1[i] > str_2[i]) {
-        return false;
-      }
-    }
-  }
-  return false;
+bool operator<(StringView str_1, StringView str_2) {
+  return str_1.compare(str_2) < 0;
 }
 
-bool operator>(const String& str_1, const String& str_2) {
+bool operator>(StringView str_1, StringView str_2) {
   return str_2 < str_1;
 }
 
-bool operator<=(const String& str_1, const String& str_2) {
+bool operator<=(StringView str_1, StringView str_2) {
   return !(str_1 > str_2);
 }
-bool operator>=(const String& str_1, const String& str_2) {
+bool operator>=(StringView str_1, StringView str_2) {
   return !(str_1 < str_2);
 }
-bool operator==(const String& str_1, const String& str_2) {
-  return !((str_1 < str_2) || (str_1 > str_2));
+bool operator==(StringView str_1, StringView str_2) {
+  return str_1.size() == str_2.size() && memcmp(str_1.data(), str_2.data(), str_1.size()) == 0;
 }
 
-bool operator!=(const String& str_1, const String& str_2) {
+bool operator!=(StringView str_1, StringView str_2) {
   return !(str_1 == str_2);
 }
 
-size_t String::find(const String& substr_) const {
-  int size_1 = substr_.size_;
-  for (int i = 0; i + size_1 <= size_; ++i) {
-    int flag = 1;
-    for (int j = i; j < i + size_1; ++j) {
-      if (substr_[j - i] != data_[j]) {
-        flag = 0;
-        break;
-      }
-    }
-    if (flag == 1) {
-      return i;
-    }
-  }
-  return size_;
+// Appends in place, so a + b + c reuses the temporary's buffer.
+String operator+(String&& str_1, StringView str_2) {
+  str_1 += str_2;
+  return std::move(str_1);
 }
-int String::rfind(const String& substr_) const {
-  int size_1 = substr_.size_;
-  for (int i = size_ - size_1; i >= 0; --i) {
-    int flag = 1;
-    for (int j = i; j < i + size_1; ++j) {
-      if (substr_[j - i] != data_[j]) {
-        flag = 0;
-        break;
-      }
-    }
-    if (flag == 1) {
-      return i;
-    }
-  }
-  return size_;
+
+String operator+(StringView str_1, StringView str_2) {
+  String result(String::Reserve(), str_1.size() + str_2.size());
+  result += str_1;
+  result += str_2;
+  return result;
 }
 
-String operator+(String str_1, const String &str_2) {
-  str_1 += str_2;
-  return str_1;
+// Exact match for literals, which convert to both String and StringView.
+String operator+(const char* str_1, StringView str_2) {
+  return StringView(str_1) + str_2;
 }
-String operator+(String str_1, const char chr) {
-  const String str_2(1, chr);
-  str_1 += str_2;
-  return str_1;
+String operator+(String&& str_1, const char chr) {
+  str_1 += chr;
+  return std::move(str_1);
+}
+
+String operator+(StringView str_1, const char chr) {
+  String result(String::Reserve(), str_1.size() + 1);
+  result += str_1;
+  result += chr;
+  return result;
+}
+
+String operator+(const char chr, StringView str_1) {
+  String result(String::Reserve(), str_1.size() + 1);
+  result += chr;
+  result += str_1;
+  return result;
+}
+
+int concatSize(StringView str) {
+  return str.size();
+}
+
+int concatSize(char) {
+  return 1;
 }
 
-String operator+(const char chr, const String &str_1) {
-  return String(1, chr) + str_1;
+template <typename... Args>
+String concat(const Args&... args) {
+  String result(String::Reserve(), (0 + ... + concatSize(args)));
+  (result += ... += args);
+  return result;
 }
 
 String String::substr(int index, int count_index) const {
@@ -227,23 +534,649 @@ void String::shrink_to_fit() {
   char *new_data_ = new char[capacity_ + 1];
   std::copy(data_, data_ + size_, new_data_);
   std::swap(data_, new_data_);
-  delete[] new_data_;
+  freeData(new_data_);
   data_[size_] = '\0';
 }
 
-std::ostream &operator<<(std::ostream &stream, const String &str) {
-  for (int i = 0; i < str.length(); ++i) {
-    stream << str[i];
+std::ostream &operator<<(std::ostream &stream, StringView str) {
+  return stream.write(str.data(), str.size());
+}
+
+template <typename Range>
+String join(const Range& range, StringView sep) {
+  int total = 0;
+  int count = 0;
+  for (const auto& piece : range) {
+    total += StringView(piece).size();
+    ++count;
   }
-  return stream;
+  String result(String::Reserve(), total + std::max(count - 1, 0) * sep.size());
+  bool first = true;
+  for (const auto& piece : range) {
+    if (!first) {
+      result += sep;
+    }
+    result += StringView(piece);
+    first = false;
+  }
+  return result;
 }
 
-std::istream &operator>>(std::istream &in, String &str) {
+template <>
+struct std::hash<String> {
+  size_t operator()(const String& str) const { return str.hash(); }
+};
+
+template <>
+struct std::hash<StringView> {
+  size_t operator()(StringView str) const { return str.hash(); }
+};
+
+// Map key that computes its hash once. The string cannot be changed after
+// construction, so the cached value never goes stale.
+class HashedString {
+  private:
+  String str_;
+  size_t hash_;
+
+  public:
+  explicit HashedString(String&& str) : str_(std::move(str)), hash_(str_.hash()) {}
+  explicit HashedString(StringView str) : str_(str), hash_(str_.hash()) {}
+  explicit HashedString(const char* chr) : HashedString(StringView(chr)) {}
+
+  const String& str() const { return str_; }
+
+  operator StringView() const { return str_; }
+
+  size_t hash() const { return hash_; }
+};
+
+bool operator==(const HashedString& str_1, const HashedString& str_2) {
+  return str_1.hash() == str_2.hash() && str_1.str() == str_2.str();
+}
+
+bool operator!=(const HashedString& str_1, const HashedString& str_2) {
+  return !(str_1 == str_2);
+}
+
+template <>
+struct std::hash<HashedString> {
+  size_t operator()(const HashedString& str) const { return str.hash(); }
+};
+
+template <typename IsDelim>
+std::istream &readUntil(std::istream &in, String &str, IsDelim is_delim) {
   str.clear();
-  char chr;
-  while (in.get(chr) && !isspace(chr) && chr != '\0') {
-    str.push_back(chr);
+  std::istream::sentry sentry(in, true);
+  if (!sentry) {
+    return in;
+  }
+  std::streambuf* buf = in.rdbuf();
+  char chunk[256];
+  int count = 0;
+  bool extracted = false;
+  while (true) {
+    int chr = buf->sbumpc();
+    if (chr == std::char_traits<char>::eof()) {
+      in.setstate(extracted ? std::ios::eofbit : std::ios::eofbit | std::ios::failbit);
+      break;
+    }
+    extracted = true;
+    if (is_delim(chr)) {
+      break;
+    }
+    chunk[count++] = static_cast<char>(chr);
+    if (count == static_cast<int>(sizeof(chunk))) {
+      str += StringView(chunk, count);
+      count = 0;
+    }
   }
+  str += StringView(chunk, count);
   return in;
 }
 
+std::istream &operator>>(std::istream &in, String &str) {
+  return readUntil(in, str, [](int chr) { return isspace(chr) || chr == '\0'; });
+}
+
+std::istream &getline(std::istream &in, String &str, char delim = '\n') {
+  return readUntil(in, str, [delim](int chr) { return chr == static_cast<unsigned char>(delim); });
+}
+
+// Longest file readFile accepts: String sizes are int and the buffer also
+// holds a terminator, so the limit is INT_MAX - 1 bytes (2 GiB minus 2).
+constexpr std::streamoff READ_FILE_LIMIT = INT_MAX - 1;
+
+// Returns false, leaving str unchanged, if the file cannot be read in full
+// or is longer than READ_FILE_LIMIT.
+bool readFile(const char* path, String &str) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::streamoff size = in.seekg(0, std::ios::end).tellg();
+  if (size < 0) {
+    in.clear();
+    String result;
+    char chunk[4096];
+    while (in.read(chunk, sizeof(chunk)) || in.gcount() > 0) {
+      if (in.gcount() > READ_FILE_LIMIT - result.size()) {
+        return false;
+      }
+      result += StringView(chunk, static_cast<int>(in.gcount()));
+    }
+    if (in.bad()) {
+      return false;
+    }
+    str = std::move(result);
+    return true;
+  }
+  if (size > READ_FILE_LIMIT) {
+    return false;
+  }
+  in.seekg(0, std::ios::beg);
+  String result(static_cast<int>(size), '\0');
+  in.read(result.data(), size);
+  if (in.gcount() != size || in.peek() != std::char_traits<char>::eof()) {
+    return false;
+  }
+  str = std::move(result);
+  return true;
+}
+
+
+class SharedString {
+  private:
+  struct Buffer {
+    std::atomic<int> refs;
+    int capacity;
+
+    char* chars() { return reinterpret_cast<char*>(this + 1); }
+  };
+
+  Buffer* buffer_ = nullptr;
+  int size_ = 0;
+  bool shareable_ = true;
+
+  static Buffer* allocate(int capacity);
+  static void release(Buffer* buffer);
+  void detach(int new_capacity);
+
+  public:
+  SharedString() = default;
+
+  SharedString(StringView str) : buffer_(str.empty() ? nullptr : allocate(str.size())), size_(str.size()) {
+    if (buffer_ != nullptr) {
+      std::copy(str.data(), str.data() + size_, buffer_->chars());
+      buffer_->chars()[size_] = '\0';
+    }
+  }
+
+  SharedString(const char* chr) : SharedString(StringView(chr)) {}
+
+  SharedString(const SharedString& str);
+
+  SharedString(SharedString&& str) : buffer_(str.buffer_), size_(str.size_), shareable_(str.shareable_) {
+    str.buffer_ = nullptr;
+    str.size_ = 0;
+  }
+
+  SharedString& operator=(SharedString str) {
+    std::swap(buffer_, str.buffer_);
+    std::swap(size_, str.size_);
+    std::swap(shareable_, str.shareable_);
+    return *this;
+  }
+
+  SharedString& operator+=(StringView str);
+
+  int length() const { return size_; }
+
+  int size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  int use_count() const { return buffer_ == nullptr ? 0 : buffer_->refs.load(std::memory_order_relaxed); }
+
+  const char& operator[](int index) const { return buffer_->chars()[index]; }
+
+  char& operator[](int index) {
+    detach(size_);
+    shareable_ = false;
+    return buffer_->chars()[index];
+  }
+
+  const char* data() const { return buffer_ == nullptr ? "" : buffer_->chars(); }
+
+  void push_back(const char& chr) { *this += StringView(&chr, 1); }
+
+  operator StringView() const { return StringView(data(), size_); }
+
+  ~SharedString() { release(buffer_); }
+};
+
+SharedString::Buffer* SharedString::allocate(int capacity) {
+  Buffer* buffer = static_cast<Buffer*>(::operator new(sizeof(Buffer) + capacity + 1));
+  new (&buffer->refs) std::atomic<int>(1);
+  buffer->capacity = capacity;
+  return buffer;
+}
+
+void SharedString::release(Buffer* buffer) {
+  if (buffer != nullptr && buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    ::operator delete(buffer);
+  }
+}
+
+void SharedString::detach(int new_capacity) {
+  if (buffer_ != nullptr && new_capacity <= buffer_->capacity &&
+      buffer_->refs.load(std::memory_order_acquire) == 1) {
+    return;
+  }
+  Buffer* buffer = allocate(new_capacity);
+  std::copy(data(), data() + size_, buffer->chars());
+  buffer->chars()[size_] = '\0';
+  release(buffer_);
+  buffer_ = buffer;
+}
+
+SharedString::SharedString(const SharedString& str) : buffer_(str.buffer_), size_(str.size_) {
+  if (buffer_ == nullptr) {
+    return;
+  }
+  if (str.shareable_) {
+    buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer_ = allocate(size_);
+  std::copy(str.data(), str.data() + size_, buffer_->chars());
+  buffer_->chars()[size_] = '\0';
+}
+
+SharedString& SharedString::operator+=(StringView str) {
+  if (str.empty()) {
+    return *this;
+  }
+  int new_size_ = size_ + str.size();
+  Buffer* old_buffer = nullptr;
+  if (buffer_ == nullptr || new_size_ > buffer_->capacity || buffer_->refs.load(std::memory_order_acquire) != 1) {
+    Buffer* buffer = allocate(std::max(new_size_, 2 * size_));
+    std::copy(data(), data() + size_, buffer->chars());
+    old_buffer = buffer_;
+    buffer_ = buffer;
+  }
+  std::copy(str.data(), str.data() + str.size(), buffer_->chars() + size_);
+  size_ = new_size_;
+  buffer_->chars()[size_] = '\0';
+  release(old_buffer);
+  return *this;
+}
+
+template <>
+struct std::hash<SharedString> {
+  size_t operator()(const SharedString& str) const { return hashBytes(str.data(), str.size()); }
+};
+
+class Rope {
+  private:
+  static const int LEAF_SIZE = 512;
+
+  struct Node {
+    String leaf;
+    std::shared_ptr<const Node> left;
+    std::shared_ptr<const Node> right;
+    int size = 0;
+    int depth = 0;
+
+    Node(StringView str) : leaf(str), size(str.size()) {}
+    Node(std::shared_ptr<const Node> lhs, std::shared_ptr<const Node> rhs)
+      : left(std::move(lhs)), right(std::move(rhs)), size(left->size + right->size),
+        depth(std::max(left->depth, right->depth) + 1) {}
+  };
+
+  using NodePtr = std::shared_ptr<const Node>;
+  NodePtr root;
+
+  explicit Rope(NodePtr node) : root(std::move(node)) {}
+
+  static NodePtr makeNode(NodePtr lhs, NodePtr rhs) { return std::make_shared<const Node>(std::move(lhs), std::move(rhs)); }
+  static NodePtr join(const NodePtr& lhs, const NodePtr& rhs);
+  static std::pair<NodePtr, NodePtr> split(const NodePtr& node, int index);
+
+  template <typename Func>
+  static void forEachLeaf(const Node* node, Func&& func) {
+    while (node != nullptr) {
+      if (node->depth == 0) {
+        func(StringView(node->leaf));
+        return;
+      }
+      forEachLeaf(node->left.get(), func);
+      node = node->right.get();
+    }
+  }
+
+  public:
+  Rope() = default;
+
+  explicit Rope(StringView str) : root(str.empty() ? nullptr : std::make_shared<const Node>(str)) {}
+
+  int length() const { return root == nullptr ? 0 : root->size; }
+
+  int size() const { return length(); }
+
+  bool empty() const { return root == nullptr; }
+
+  char operator[](int index) const;
+
+  Rope& operator+=(const Rope& rope);
+  Rope& operator+=(StringView str);
+
+  void insert(int index, const Rope& rope);
+  void insert(int index, StringView str) { insert(index, Rope(str)); }
+
+  void erase(int index, int count);
+
+  Rope substr(int index, int count) const;
+
+  String toString() const;
+
+  template <typename Func>
+  void forEachChunk(Func&& func) const {
+    forEachLeaf(root.get(), func);
+  }
+};
+
+Rope::NodePtr Rope::join(const NodePtr& lhs, const NodePtr& rhs) {
+  if (lhs == nullptr) {
+    return rhs;
+  }
+  if (rhs == nullptr) {
+    return lhs;
+  }
+  if (rhs->depth == 0 && rhs->size <= LEAF_SIZE) {
+    if (lhs->depth == 0 && lhs->size + rhs->size <= LEAF_SIZE) {
+      return std::make_shared<const Node>(StringView(concat(lhs->leaf, rhs->leaf)));
+    }
+    if (lhs->depth > 0 && lhs->right->depth == 0 && lhs->right->size + rhs->size <= LEAF_SIZE) {
+      return join(lhs->left, join(lhs->right, rhs));
+    }
+  }
+  if (lhs->depth > rhs->depth + 1) {
+    NodePtr right = join(lhs->right, rhs);
+    if (right->depth <= lhs->left->depth + 1) {
+      return makeNode(lhs->left, right);
+    }
+    if (right->left->depth <= right->right->depth) {
+      return makeNode(makeNode(lhs->left, right->left), right->right);
+    }
+    return makeNode(makeNode(lhs->left, right->left->left), makeNode(right->left->right, right->right));
+  }
+  if (rhs->depth > lhs->depth + 1) {
+    NodePtr left = join(lhs, rhs->left);
+    if (left->depth <= rhs->right->depth + 1) {
+      return makeNode(left, rhs->right);
+    }
+    if (left->right->depth <= left->left->depth) {
+      return makeNode(left->left, makeNode(left->right, rhs->right));
+    }
+    return makeNode(makeNode(left->left, left->right->left), makeNode(left->right->right, rhs->right));
+  }
+  return makeNode(lhs, rhs);
+}
+
+std::pair<Rope::NodePtr, Rope::NodePtr> Rope::split(const NodePtr& node, int index) {
+  if (node == nullptr || index <= 0) {
+    return {nullptr, node};
+  }
+  if (index >= node->size) {
+    return {node, nullptr};
+  }
+  if (node->depth == 0) {
+    StringView leaf = node->leaf;
+    return {std::make_shared<const Node>(leaf.substr(0, index)),
+            std::make_shared<const Node>(leaf.substr(index, leaf.size() - index))};
+  }
+  if (index < node->left->size) {
+    auto parts = split(node->left, index);
+    return {parts.first, join(parts.second, node->right)};
+  }
+  auto parts = split(node->right, index - node->left->size);
+  return {join(node->left, parts.first), parts.second};
+}
+
+char Rope::operator[](int index) const {
+  const Node* node = root.get();
+  while (node->depth > 0) {
+    if (index < node->left->size) {
+      node = node->left.get();
+    } else {
+      index -= node->left->size;
+      node = node->right.get();
+    }
+  }
+  return node->leaf[index];
+}
+
+Rope& Rope::operator+=(const Rope& rope) {
+  root = join(root, rope.root);
+  return *this;
+}
+
+Rope& Rope::operator+=(StringView str) {
+  return *this += Rope(str);
+}
+
+void Rope::insert(int index, const Rope& rope) {
+  auto parts = split(root, index);
+  root = join(join(parts.first, rope.root), parts.second);
+}
+
+void Rope::erase(int index, int count) {
+  auto head = split(root, index);
+  root = join(head.first, split(head.second, count).second);
+}
+
+Rope Rope::substr(int index, int count) const {
+  return Rope(split(split(root, index).second, count).first);
+}
+
+String Rope::toString() const {
+  String result;
+  result.reserve(length());
+  forEachChunk([&result](StringView chunk) { result += chunk; });
+  return result;
+}
+
+Rope operator+(Rope rope_1, const Rope& rope_2) {
+  rope_1 += rope_2;
+  return rope_1;
+}
+
+Rope operator+(Rope rope_1, StringView str_2) {
+  rope_1 += str_2;
+  return rope_1;
+}
+
+std::ostream &operator<<(std::ostream &stream, const Rope& rope) {
+  rope.forEachChunk([&stream](StringView chunk) { stream << chunk; });
+  return stream;
+}
+
+int asciiPrefix(StringView str) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str.data());
+  int index = 0;
+#ifdef __SSE2__
+  for (; index + 16 <= str.size(); index += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + index));
+    if (_mm_movemask_epi8(block) != 0) {
+      break;
+    }
+  }
+#endif
+  for (; index + 8 <= str.size(); index += 8) {
+    if ((wyRead8(bytes + index) & 0x8080808080808080ull) != 0) {
+      break;
+    }
+  }
+  while (index < str.size() && bytes[index] < 0x80) {
+    ++index;
+  }
+  return index;
+}
+
+char32_t decodeUtf8(StringView str, int& index) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str.data());
+  unsigned char lead = bytes[index];
+  if (lead < 0x80) {
+    ++index;
+    return lead;
+  }
+  int length = 0;
+  char32_t code = 0;
+  char32_t min_code = 0;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    length = 2;
+    code = lead & 0x1F;
+    min_code = 0x80;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    length = 3;
+    code = lead & 0x0F;
+    min_code = 0x800;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    length = 4;
+    code = lead & 0x07;
+    min_code = 0x10000;
+  }
+  if (length == 0 || index + length > str.size()) {
+    ++index;
+    return 0xFFFD;
+  }
+  for (int i = 1; i < length; ++i) {
+    if ((bytes[index + i] & 0xC0) != 0x80) {
+      ++index;
+      return 0xFFFD;
+    }
+    code = (code << 6) | (bytes[index + i] & 0x3F);
+  }
+  if (code < min_code || code > 0x10FFFF || (code >= 0xD800 && code <= 0xDFFF)) {
+    ++index;
+    return 0xFFFD;
+  }
+  index += length;
+  return code;
+}
+
+bool isValidUtf8(StringView str) {
+  int index = asciiPrefix(str);
+  while (index < str.size()) {
+    int start = index;
+    if (decodeUtf8(str, index) == 0xFFFD && index - start == 1) {
+      return false;
+    }
+    index += asciiPrefix(str.substr(index, str.size() - index));
+  }
+  return true;
+}
+
+int countCodePoints(StringView str) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(str.data());
+  int continuation = 0;
+  int index = 0;
+  for (; index + 8 <= str.size(); index += 8) {
+    uint64_t block = wyRead8(bytes + index);
+    continuation += __builtin_popcountll(block & ~(block << 1) & 0x8080808080808080ull);
+  }
+  for (; index < str.size(); ++index) {
+    continuation += (bytes[index] & 0xC0) == 0x80;
+  }
+  return str.size() - continuation;
+}
+
+class Utf8View {
+  private:
+  StringView str_;
+
+  public:
+  class Iterator {
+    private:
+    StringView str_;
+    int index_ = 0;
+
+    public:
+    using value_type = char32_t;
+    using reference = char32_t;
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = ptrdiff_t;
+
+    Iterator() = default;
+    Iterator(StringView str, int index) : str_(str), index_(index) {}
+
+    int index() const { return index_; }
+
+    char32_t operator*() const {
+      int index = index_;
+      return decodeUtf8(str_, index);
+    }
+
+    Iterator& operator++() {
+      decodeUtf8(str_, index_);
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator copy = *this;
+      ++*this;
+      return copy;
+    }
+
+    bool operator==(const Iterator& it) const { return index_ == it.index_; }
+    bool operator!=(const Iterator& it) const { return index_ != it.index_; }
+  };
+
+  Utf8View(StringView str) : str_(str) {}
+
+  Iterator begin() const { return Iterator(str_, 0); }
+  Iterator end() const { return Iterator(str_, str_.size()); }
+};
+
+char32_t foldCase(char32_t code) {
+  if ((code >= 'A' && code <= 'Z') || (code >= 0xC0 && code <= 0xDE && code != 0xD7) ||
+      (code >= 0x391 && code <= 0x3A9 && code != 0x3A2) || (code >= 0x410 && code <= 0x42F)) {
+    return code + 0x20;
+  }
+  if (code >= 0x400 && code <= 0x40F) {
+    return code + 0x50;
+  }
+  return code;
+}
+
+int compareFolded(StringView str_1, StringView str_2) {
+  if (str_1.size() != str_2.size()) {
+    return str_1.size() < str_2.size() ? -1 : 1;
+  }
+  int index_1 = 0;
+  int index_2 = 0;
+  while (index_1 < str_1.size() && index_2 < str_2.size()) {
+    unsigned char byte_1 = str_1[index_1];
+    unsigned char byte_2 = str_2[index_2];
+    if ((byte_1 | byte_2) < 0x80) {
+      char32_t code_1 = foldCase(byte_1);
+      char32_t code_2 = foldCase(byte_2);
+      if (code_1 != code_2) {
+        return code_1 < code_2 ? -1 : 1;
+      }
+      ++index_1;
+      ++index_2;
+      continue;
+    }
+    char32_t code_1 = foldCase(decodeUtf8(str_1, index_1));
+    char32_t code_2 = foldCase(decodeUtf8(str_2, index_2));
+    if (code_1 != code_2) {
+      return code_1 < code_2 ? -1 : 1;
+    }
+  }
+  return (index_1 < str_1.size()) - (index_2 < str_2.size());
+}
+
+bool equalsFolded(StringView str_1, StringView str_2) {
+  return compareFolded(str_1, str_2) == 0;
+}
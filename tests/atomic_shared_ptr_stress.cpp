@@ -0,0 +1,89 @@
+// Hammers one AtomicSharedPtr with several writers and readers at once.
+//
+//   g++ -std=c++20 -O1 -g -pthread -fsanitize=address,undefined tests/atomic_shared_ptr_stress.cpp -o stress
+//   g++ -std=c++20 -O1 -g -pthread -fsanitize=thread tests/atomic_shared_ptr_stress.cpp -o stress
+//   ./stress [writers] [readers] [iterations]
+//
+// Exits non-zero when a reader sees a destroyed value or an object leaks.
+#include "../smart_pointers.h"
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr long kAlive = 0x5eed;
+
+std::atomic<long> live {0};
+std::atomic<long> failures {0};
+
+struct Tracked {
+  long state = kAlive;
+  long value;
+
+  explicit Tracked(long v) : value(v) { live.fetch_add(1, std::memory_order_relaxed); }
+
+  ~Tracked() {
+    state = 0;
+    live.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
+void check(const SharedPtr<Tracked>& p) {
+  if (p.get() != nullptr && p->state != kAlive) {
+    failures.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int writers = argc > 1 ? std::atoi(argv[1]) : 4;
+  int readers = argc > 2 ? std::atoi(argv[2]) : 6;
+  long iterations = argc > 3 ? std::atol(argv[3]) : 20000;
+
+  {
+    AtomicSharedPtr<Tracked> shared(makeShared<Tracked>(0));
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+      threads.emplace_back([&, w] {
+        for (long i = 0; i < iterations; ++i) {
+          long value = w * iterations + i;
+          switch (i % 4) {
+            case 0:
+              shared.store(makeShared<Tracked>(value));
+              break;
+            case 1:
+              check(shared.exchange(makeShared<Tracked>(value)));
+              break;
+            case 2: {
+              SharedPtr<Tracked> expected = shared.load();
+              check(expected);
+              shared.compare_exchange(expected, makeShared<Tracked>(value));
+              check(expected);
+              break;
+            }
+            default:
+              shared.store(SharedPtr<Tracked>());
+              break;
+          }
+        }
+      });
+    }
+    for (int r = 0; r < readers; ++r) {
+      threads.emplace_back([&] {
+        for (long i = 0; i < iterations * 2; ++i) {
+          check(shared.load());
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  long leaked = live.load();
+  std::cout << "failures: " << failures.load() << ", leaked: " << leaked << '\n';
+  return failures.load() == 0 && leaked == 0 ? 0 : 1;
+}
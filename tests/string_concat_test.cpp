@@ -0,0 +1,48 @@
+// Checks operator+ for every combination of String, StringView, literal and char.
+//
+//   g++ -std=c++20 -O1 -g -fsanitize=address,undefined tests/string_concat_test.cpp -o string_concat_test
+//   ./string_concat_test
+#include "../string.h"
+
+#include <cassert>
+#include <type_traits>
+
+namespace {
+
+template <typename Left, typename Right>
+void check(Left&& left, Right&& right, StringView expected) {
+  auto result = std::forward<Left>(left) + std::forward<Right>(right);
+  static_assert(std::is_same_v<decltype(result), String>);
+  assert(result == expected);
+}
+
+}  // namespace
+
+int main() {
+  String s("ab");
+  StringView sv("cd");
+  const char* lit = "ef";
+
+  check(s, s, "abab");
+  check(s, sv, "abcd");
+  check(sv, s, "cdab");
+  check(sv, sv, "cdcd");
+  check(s, lit, "abef");
+  check(lit, s, "efab");
+  check(sv, lit, "cdef");
+  check(lit, sv, "efcd");
+  check(s, 'x', "abx");
+  check('x', s, "xab");
+  check(sv, 'x', "cdx");
+  check('x', sv, "xcd");
+  check(String("gh"), sv, "ghcd");
+  check(String("gh"), 'x', "ghx");
+  check(sv, String("gh"), "cdgh");
+  check(StringView(), StringView(), "");
+
+  String chain = s + sv + 'x' + lit + s.substr_view(1, 1);
+  assert(chain == StringView("abcdxefb"));
+  assert(s == StringView("ab"));
+
+  std::cout << "ok\n";
+}
@@ -0,0 +1,79 @@
+// Pins down which UnrolledList iterators survive erase.
+//
+//   g++ -std=c++20 -O1 -g -fsanitize=address,undefined tests/unrolled_list_test.cpp -o unrolled_list_test
+//   ./unrolled_list_test
+#include "../stackallocator.h"
+
+#include <cassert>
+#include <string>
+
+namespace {
+
+using Strings = UnrolledList<std::string, std::allocator<std::string>, 4>;
+
+// Four full nodes: [a b c d] [e f g h] [i j k l] [m n o p].
+Strings make() {
+  Strings list;
+  for (char c = 'a'; c <= 'p'; ++c) {
+    list.push_back(std::string(1, c));
+  }
+  return list;
+}
+
+Strings::iterator at(Strings& list, int index) {
+  auto it = list.begin();
+  for (int i = 0; i < index; ++i) {
+    ++it;
+  }
+  return it;
+}
+
+std::string contents(const Strings& list) {
+  std::string result;
+  for (const auto& value : list) {
+    result += value;
+  }
+  return result;
+}
+
+}  // namespace
+
+int main() {
+  {
+    // Draining the second node balances it with its successor: iterators
+    // into the first and last nodes stay valid, the third node's do not.
+    Strings list = make();
+    auto a = at(list, 0);
+    auto d = at(list, 3);
+    auto m = at(list, 12);
+    auto p = at(list, 15);
+    for (int i = 0; i < 3; ++i) {
+      list.erase(at(list, 4));
+    }
+    assert(*a == "a" && *d == "d" && *m == "m" && *p == "p");
+    assert(contents(list) == "abcdhijklmnop");
+  }
+  {
+    // Draining the last node balances it with its predecessor instead.
+    Strings list = make();
+    auto a = at(list, 0);
+    auto e = at(list, 4);
+    auto h = at(list, 7);
+    for (int i = 0; i < 3; ++i) {
+      list.erase(at(list, 12));
+    }
+    assert(*a == "a" && *e == "e" && *h == "h");
+    assert(contents(list) == "abcdefghijklp");
+  }
+  {
+    // Erasing without dropping below half full touches only the erased node.
+    Strings list = make();
+    auto e = at(list, 4);
+    auto i = at(list, 8);
+    list.erase(at(list, 3));
+    list.erase(at(list, 2));
+    assert(*e == "e" && *i == "i");
+    assert(contents(list) == "abefghijklmnop");
+  }
+  std::cout << "ok\n";
+}